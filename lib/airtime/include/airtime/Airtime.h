@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Pure LoRa time-on-air calculations (SX126x datasheet, section 6.1.4), free of any Arduino dependency.
+namespace airtime {
+struct Modulation
+{
+  uint8_t spreadingFactor; // 5..12
+  float bandwidthKhz;
+  uint8_t codingRate; // denominator of 4/x, 5..8
+  uint16_t preambleLength;
+  bool explicitHeader;
+  bool crc;
+};
+
+// Modulation of the gateway radio, lora::LoraClient sets the SX1262 up with it. Kept here, so the airtime of its
+// packets can be calculated without the radio driver, e.g. by the host benchmark.
+constexpr Modulation g_gatewayModulation{
+  .spreadingFactor = 8U,
+  .bandwidthKhz = 125.0F,
+  .codingRate = 5U,
+  .preambleLength = 6U,
+  .explicitHeader = true,
+  .crc = true,
+};
+
+// Low data rate optimization is mandatory for symbol times of 16 ms and above.
+bool lowDataRateOptimize(const Modulation& modulation);
+uint32_t symbolTimeUs(const Modulation& modulation);
+uint32_t symbolCount(const Modulation& modulation, std::size_t payloadLength);
+uint32_t timeOnAirUs(const Modulation& modulation, std::size_t payloadLength);
+
+// Probability that a packet collides on a pure ALOHA channel with the given utilisation (0..1).
+float collisionProbability(float utilisation);
+} // namespace airtime
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace airtime {
+
+// EU868 sub-bands as defined by ETSI EN 300 220-2.
+struct SubBand
+{
+  float lowerMhz;
+  float upperMhz;
+  float dutyCycle; // fraction, e.g. 0.01 for 1 %
+};
+
+std::optional<std::size_t> subBandIndex(float frequencyMhz);
+const SubBand* subBandFor(float frequencyMhz);
+
+// Airtime accumulated over the last hour, kept in one minute buckets. Only differences of millis() timestamps are
+// used, so the window keeps working when millis() wraps around.
+class SlidingWindow
+{
+public:
+  static constexpr uint32_t windowMs{3'600'000U};
+  static constexpr std::size_t bucketCount{60U};
+  static constexpr uint32_t bucketMs{windowMs / bucketCount};
+
+  SlidingWindow() noexcept;
+
+  void record(uint32_t airtimeUs, uint32_t nowMs);
+  [[nodiscard]] uint64_t totalUs(uint32_t nowMs) const;
+  [[nodiscard]] float utilisation(uint32_t nowMs) const;
+
+private:
+  struct Bucket
+  {
+    uint32_t startMs;
+    uint32_t airtimeUs;
+  };
+
+  std::array<Bucket, bucketCount> m_buckets;
+  std::size_t m_current;
+};
+
+class DutyCycleAccountant
+{
+public:
+  static constexpr std::size_t subBandCount{6U};
+
+  // Returns false if the frequency is outside of all known sub-bands.
+  bool record(float frequencyMhz, uint32_t airtimeUs, uint32_t nowMs);
+  [[nodiscard]] float utilisation(float frequencyMhz, uint32_t nowMs) const;
+  [[nodiscard]] bool canTransmit(float frequencyMhz, uint32_t airtimeUs, uint32_t nowMs) const;
+
+private:
+  std::array<SlidingWindow, subBandCount> m_windows;
+};
+} // namespace airtime
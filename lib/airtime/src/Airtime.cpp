@@ -0,0 +1,63 @@
+#include <airtime/Airtime.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace airtime {
+namespace {
+constexpr float g_lowDataRateSymbolTimeUs{16000.0F};
+
+float
+symbolTime(const Modulation& modulation)
+{
+  return static_cast<float>(1U << modulation.spreadingFactor) * 1000.0F / modulation.bandwidthKhz;
+}
+} // namespace
+
+bool
+lowDataRateOptimize(const Modulation& modulation)
+{
+  return symbolTime(modulation) >= g_lowDataRateSymbolTimeUs;
+}
+
+uint32_t
+symbolTimeUs(const Modulation& modulation)
+{
+  return static_cast<uint32_t>(std::lround(symbolTime(modulation)));
+}
+
+uint32_t
+symbolCount(const Modulation& modulation, const std::size_t payloadLength)
+{
+  const auto spreadingFactor{static_cast<int32_t>(modulation.spreadingFactor)};
+  const bool shortSpreadingFactor{spreadingFactor < 7};
+
+  const int32_t crcBits{modulation.crc ? 16 : 0};
+  const int32_t headerBits{modulation.explicitHeader ? 20 : 0};
+  const int32_t syncBits{shortSpreadingFactor ? 0 : 8};
+  const int32_t bitsPerSymbol{4 * (lowDataRateOptimize(modulation) ? spreadingFactor - 2 : spreadingFactor)};
+
+  const int32_t payloadBits{
+    std::max(static_cast<int32_t>(8 * payloadLength) + crcBits - 4 * spreadingFactor + syncBits + headerBits, 0)};
+  const int32_t codewords{(payloadBits + bitsPerSymbol - 1) / bitsPerSymbol};
+
+  return static_cast<uint32_t>(8 + codewords * static_cast<int32_t>(modulation.codingRate));
+}
+
+uint32_t
+timeOnAirUs(const Modulation& modulation, const std::size_t payloadLength)
+{
+  // the preamble is followed by 4.25 sync symbols, 6.25 for SF5 and SF6
+  const float syncSymbols{modulation.spreadingFactor < 7 ? 6.25F : 4.25F};
+  const float symbols{static_cast<float>(modulation.preambleLength) + syncSymbols +
+                      static_cast<float>(symbolCount(modulation, payloadLength))};
+
+  return static_cast<uint32_t>(std::lround(symbols * symbolTime(modulation)));
+}
+
+float
+collisionProbability(const float utilisation)
+{
+  return 1.0F - std::exp(-2.0F * std::max(utilisation, 0.0F));
+}
+} // namespace airtime
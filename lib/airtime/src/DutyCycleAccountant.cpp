@@ -0,0 +1,103 @@
+#include <airtime/DutyCycleAccountant.h>
+
+#include <algorithm>
+
+namespace airtime {
+namespace {
+constexpr std::array<SubBand, DutyCycleAccountant::subBandCount> g_subBands{{
+  {863.0F, 865.0F, 0.001F},
+  {865.0F, 868.0F, 0.01F},
+  {868.0F, 868.6F, 0.01F},
+  {868.7F, 869.2F, 0.001F},
+  {869.4F, 869.65F, 0.1F},
+  {869.7F, 870.0F, 0.01F},
+}};
+} // namespace
+
+std::optional<std::size_t>
+subBandIndex(const float frequencyMhz)
+{
+  for (std::size_t index{0U}; index < g_subBands.size(); ++index) {
+    if (frequencyMhz >= g_subBands[index].lowerMhz and frequencyMhz < g_subBands[index].upperMhz) {
+      return index;
+    }
+  }
+  return std::nullopt;
+}
+
+const SubBand*
+subBandFor(const float frequencyMhz)
+{
+  const auto index{subBandIndex(frequencyMhz)};
+  return index ? &g_subBands[*index] : nullptr;
+}
+
+SlidingWindow::SlidingWindow() noexcept
+  : m_buckets{}
+  , m_current{0U}
+{
+}
+
+void
+SlidingWindow::record(const uint32_t airtimeUs, const uint32_t nowMs)
+{
+  const uint32_t elapsedBuckets{(nowMs - m_buckets[m_current].startMs) / bucketMs};
+  if (elapsedBuckets > 0U) {
+    // the buckets stepped over are cleared, so no stale airtime survives a millis() wrap
+    const uint32_t startMs{m_buckets[m_current].startMs + (elapsedBuckets * bucketMs)};
+    for (uint32_t step{0U}; step < std::min<uint32_t>(elapsedBuckets, bucketCount); ++step) {
+      m_current = (m_current + 1U) % bucketCount;
+      m_buckets[m_current] = {startMs, 0U};
+    }
+  }
+  m_buckets[m_current].airtimeUs += airtimeUs;
+}
+
+uint64_t
+SlidingWindow::totalUs(const uint32_t nowMs) const
+{
+  uint64_t total{0U};
+  for (const auto& bucket : m_buckets) {
+    if (nowMs - bucket.startMs < windowMs) {
+      total += bucket.airtimeUs;
+    }
+  }
+  return total;
+}
+
+float
+SlidingWindow::utilisation(const uint32_t nowMs) const
+{
+  return static_cast<float>(totalUs(nowMs)) / (static_cast<float>(windowMs) * 1000.0F);
+}
+
+bool
+DutyCycleAccountant::record(const float frequencyMhz, const uint32_t airtimeUs, const uint32_t nowMs)
+{
+  const auto index{subBandIndex(frequencyMhz)};
+  if (not index) {
+    return false;
+  }
+  m_windows[*index].record(airtimeUs, nowMs);
+  return true;
+}
+
+float
+DutyCycleAccountant::utilisation(const float frequencyMhz, const uint32_t nowMs) const
+{
+  const auto index{subBandIndex(frequencyMhz)};
+  return index ? m_windows[*index].utilisation(nowMs) : 0.0F;
+}
+
+bool
+DutyCycleAccountant::canTransmit(const float frequencyMhz, const uint32_t airtimeUs, const uint32_t nowMs) const
+{
+  const auto index{subBandIndex(frequencyMhz)};
+  if (not index) {
+    return false;
+  }
+  const auto budgetUs{static_cast<uint64_t>(static_cast<float>(SlidingWindow::windowMs) * 1000.0F *
+                                            g_subBands[*index].dutyCycle)};
+  return m_windows[*index].totalUs(nowMs) + airtimeUs <= budgetUs;
+}
+} // namespace airtime
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+#include <config/GatewayConfig.h>
+
+namespace config {
+enum class ConfigSlot : std::uint8_t
+{
+  Current,
+  Fallback, // last configuration known to connect, kept while a network change is tried
+  Rejected, // network change that did not connect, the retained MQTT message would apply it again
+};
+
+class ConfigStore
+{
+public:
+  explicit ConfigStore(const char* nvsNamespace) noexcept;
+
+  [[nodiscard]] std::optional<GatewayConfig> load(ConfigSlot slot = ConfigSlot::Current) const;
+  bool save(const GatewayConfig& config, ConfigSlot slot = ConfigSlot::Current) const;
+  void clear(ConfigSlot slot) const;
+
+private:
+  const char* m_nvsNamespace;
+};
+} // namespace config
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+
+#include <Arduino.h>
+
+namespace config {
+// Persists the keys per node for which a Home Assistant device discovery config has been published, so the gateway
+// does not overwrite a retained config with a subset of its keys after a restart.
+class DiscoveryStore
+{
+public:
+  using KeyMasks = std::map<String, std::uint32_t>;
+
+  explicit DiscoveryStore(const char* nvsNamespace) noexcept;
+
+  [[nodiscard]] KeyMasks load() const;
+  bool save(const KeyMasks& keyMasks) const;
+
+private:
+  const char* m_nvsNamespace;
+};
+} // namespace config
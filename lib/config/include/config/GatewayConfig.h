@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include <Arduino.h>
+
+#include <crypto/Aes.hpp>
+#include <crypto/KeyRing.hpp>
+
+namespace config {
+struct NodeKey
+{
+  crypto::KeyRing::KeyId keyId;
+  crypto::Aes::Array key;
+  std::optional<crypto::Aes::Array> previousKey;
+
+  bool operator==(const NodeKey& other) const;
+};
+
+struct GatewayConfig
+{
+  String wifiSsid;
+  String wifiPassword;
+  String mqttUsername;
+  String mqttPassword;
+  String gatewayId;
+  String mqttServer;
+  std::uint16_t mqttPort;
+  crypto::Aes::Array aesKey;
+  std::optional<crypto::Aes::Array> previousAesKey; // still accepted while nodes are being rotated
+  std::vector<NodeKey> nodeKeys;                     // key ID 0 is reserved for aesKey
+
+  bool operator==(const GatewayConfig& other) const;
+  bool operator!=(const GatewayConfig& other) const;
+};
+
+// Changes to anything but the AES keys need a restart to take effect.
+bool requiresRestart(const GatewayConfig& current, const GatewayConfig& updated);
+
+crypto::KeyRing makeKeyRing(const GatewayConfig& config);
+
+// Compact versioned binary layout used for persisting the configuration. decode() applies the same validation as
+// applyJson().
+std::vector<std::uint8_t> encode(const GatewayConfig& config);
+std::optional<GatewayConfig> decode(const std::uint8_t* data, std::size_t length);
+
+// Applies a JSON configuration update on top of the current configuration. Missing fields keep their value,
+// an empty "aes_key_previous" ends a key rotation and "node_keys" replaces all node keys. Returns std::nullopt if
+// any field is invalid.
+std::optional<GatewayConfig> applyJson(const GatewayConfig& current, const char* payload);
+} // namespace config
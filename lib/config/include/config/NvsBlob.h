@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Whole blobs in the Preferences (NVS) storage, shared by the stores.
+namespace config {
+// empty if the namespace or the key does not exist yet
+std::vector<std::uint8_t> loadBlob(const char* nvsNamespace, const char* key);
+bool saveBlob(const char* nvsNamespace, const char* key, const std::vector<std::uint8_t>& data);
+void removeBlob(const char* nvsNamespace, const char* key);
+} // namespace config
@@ -0,0 +1,54 @@
+#include <config/ConfigStore.h>
+
+#include <config/NvsBlob.h>
+#include <logging/Log.h>
+
+namespace config {
+namespace {
+const char*
+keyFor(const ConfigSlot slot)
+{
+  switch (slot) {
+    case ConfigSlot::Current:
+      return "config";
+    case ConfigSlot::Fallback:
+      return "fallback";
+    case ConfigSlot::Rejected:
+      return "rejected";
+  }
+  return "config";
+}
+} // namespace
+
+ConfigStore::ConfigStore(const char* const nvsNamespace) noexcept
+  : m_nvsNamespace{nvsNamespace}
+{
+}
+
+std::optional<GatewayConfig>
+ConfigStore::load(const ConfigSlot slot) const
+{
+  const auto blob{loadBlob(m_nvsNamespace, keyFor(slot))};
+  if (blob.empty()) {
+    return std::nullopt;
+  }
+
+  auto config{decode(blob.data(), blob.size())};
+  if (not config) {
+    LOG_ERROR("Stored configuration is invalid");
+  }
+  return config;
+}
+
+bool
+ConfigStore::save(const GatewayConfig& config, const ConfigSlot slot) const
+{
+  return saveBlob(m_nvsNamespace, keyFor(slot), encode(config));
+}
+
+void
+ConfigStore::clear(const ConfigSlot slot) const
+{
+  removeBlob(m_nvsNamespace, keyFor(slot));
+}
+} // namespace config
@@ -0,0 +1,79 @@
+#include <config/DiscoveryStore.h>
+
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include <config/NvsBlob.h>
+#include <logging/Log.h>
+
+namespace config {
+namespace {
+constexpr auto g_discoveryKey{"discovery"};
+constexpr std::uint8_t g_layoutVersion{1U};
+constexpr std::size_t g_maskLength{sizeof(std::uint32_t)};
+
+// Layout: version, then per node: node ID length, node ID, key mask (little endian)
+std::vector<std::uint8_t>
+encode(const DiscoveryStore::KeyMasks& keyMasks)
+{
+  std::vector<std::uint8_t> output;
+  output.push_back(g_layoutVersion);
+  for (const auto& [nodeId, mask] : keyMasks) {
+    if (nodeId.length() > std::numeric_limits<std::uint8_t>::max()) {
+      continue;
+    }
+    output.push_back(static_cast<std::uint8_t>(nodeId.length()));
+    output.insert(output.end(), nodeId.c_str(), nodeId.c_str() + nodeId.length());
+    for (std::size_t index{0U}; index < g_maskLength; ++index) {
+      output.push_back(static_cast<std::uint8_t>(mask >> (index * 8U)));
+    }
+  }
+  return output;
+}
+
+DiscoveryStore::KeyMasks
+decode(const std::uint8_t* const data, const std::size_t length)
+{
+  if (length == 0U or data[0] != g_layoutVersion) {
+    return {};
+  }
+
+  DiscoveryStore::KeyMasks keyMasks;
+  std::size_t offset{1U};
+  while (offset < length) {
+    const std::size_t idLength{data[offset++]};
+    if (length - offset < idLength + g_maskLength) {
+      LOG_ERROR("Stored discovery state is invalid");
+      return {};
+    }
+    String nodeId{reinterpret_cast<const char*>(data + offset), idLength};
+    offset += idLength;
+    std::uint32_t mask{0U};
+    for (std::size_t index{0U}; index < g_maskLength; ++index) {
+      mask |= static_cast<std::uint32_t>(data[offset++]) << (index * 8U);
+    }
+    keyMasks.emplace(std::move(nodeId), mask);
+  }
+  return keyMasks;
+}
+} // namespace
+
+DiscoveryStore::DiscoveryStore(const char* const nvsNamespace) noexcept
+  : m_nvsNamespace{nvsNamespace}
+{
+}
+
+DiscoveryStore::KeyMasks
+DiscoveryStore::load() const
+{
+  const auto blob{loadBlob(m_nvsNamespace, g_discoveryKey)};
+  return decode(blob.data(), blob.size());
+}
+
+bool
+DiscoveryStore::save(const KeyMasks& keyMasks) const
+{
+  return saveBlob(m_nvsNamespace, g_discoveryKey, encode(keyMasks));
+}
+} // namespace config
@@ -0,0 +1,401 @@
+#include <config/GatewayConfig.h>
+
+#include <algorithm>
+#include <cctype>
+#include <limits>
+
+#include <ArduinoJson.h>
+
+namespace config {
+namespace {
+constexpr std::uint8_t g_layoutVersionWithoutNodeKeys{1U};
+constexpr std::uint8_t g_layoutVersion{2U};
+constexpr std::uint8_t g_flagPreviousAesKey{0x01U};
+constexpr crypto::KeyRing::KeyId g_defaultKeyId{0U};
+
+struct StringField
+{
+  const char* jsonKey;
+  String GatewayConfig::* member;
+  std::size_t minLength;
+  std::size_t maxLength;
+  bool topicSafe; // used in MQTT topics, so no wildcards or separators
+};
+
+// the order defines the binary layout, append only
+constexpr StringField g_stringFields[]{
+  {"wifi_ssid", &GatewayConfig::wifiSsid, 1U, 32U, false},
+  {"wifi_password", &GatewayConfig::wifiPassword, 0U, 63U, false},
+  {"mqtt_username", &GatewayConfig::mqttUsername, 0U, 64U, false},
+  {"mqtt_password", &GatewayConfig::mqttPassword, 0U, 64U, false},
+  {"gateway_id", &GatewayConfig::gatewayId, 1U, 12U, true}, // sent in the packet header, see PacketDecoder
+  {"mqtt_server", &GatewayConfig::mqttServer, 1U, 128U, false},
+};
+
+class Reader
+{
+public:
+  Reader(const std::uint8_t* const data, const std::size_t length)
+    : m_data{data}
+    , m_length{length}
+    , m_offset{0U}
+  {
+  }
+
+  std::optional<std::uint8_t> readByte()
+  {
+    if (m_offset >= m_length) {
+      return std::nullopt;
+    }
+    return m_data[m_offset++];
+  }
+
+  bool read(std::uint8_t* const output, const std::size_t length)
+  {
+    if (m_length - m_offset < length) {
+      return false;
+    }
+    memcpy(output, m_data + m_offset, length);
+    m_offset += length;
+    return true;
+  }
+
+  [[nodiscard]] bool atEnd() const
+  {
+    return m_offset == m_length;
+  }
+
+private:
+  const std::uint8_t* m_data;
+  std::size_t m_length;
+  std::size_t m_offset;
+};
+
+std::optional<std::uint8_t>
+hexValue(const char character)
+{
+  if (not std::isxdigit(static_cast<unsigned char>(character))) {
+    return std::nullopt;
+  }
+  if (std::isdigit(static_cast<unsigned char>(character))) {
+    return static_cast<std::uint8_t>(character - '0');
+  }
+  return static_cast<std::uint8_t>(std::tolower(static_cast<unsigned char>(character)) - 'a' + 10);
+}
+
+std::optional<crypto::Aes::Array>
+parseKey(const char* const hex)
+{
+  crypto::Aes::Array key{};
+  if (strlen(hex) != key.size() * 2U) {
+    return std::nullopt;
+  }
+  for (std::size_t index{0U}; index < key.size(); ++index) {
+    const auto high{hexValue(hex[index * 2U])};
+    const auto low{hexValue(hex[(index * 2U) + 1U])};
+    if (not high or not low) {
+      return std::nullopt;
+    }
+    key[index] = static_cast<byte>((*high << 4U) | *low);
+  }
+  return key;
+}
+
+void
+appendKeys(std::vector<std::uint8_t>& output,
+           const crypto::Aes::Array& key,
+           const std::optional<crypto::Aes::Array>& previousKey)
+{
+  output.insert(output.end(), key.begin(), key.end());
+  if (previousKey) {
+    output.insert(output.end(), previousKey->begin(), previousKey->end());
+  }
+}
+
+bool
+readKeys(Reader& reader,
+         const std::uint8_t flags,
+         crypto::Aes::Array& key,
+         std::optional<crypto::Aes::Array>& previousKey)
+{
+  if (not reader.read(key.data(), key.size())) {
+    return false;
+  }
+  if ((flags & g_flagPreviousAesKey) != 0U) {
+    crypto::Aes::Array previous{};
+    if (not reader.read(previous.data(), previous.size())) {
+      return false;
+    }
+    previousKey = previous;
+  }
+  return true;
+}
+
+std::optional<std::optional<crypto::Aes::Array>>
+parseOptionalKey(const JsonVariantConst value)
+{
+  if (not value.is<const char*>()) {
+    return std::nullopt;
+  }
+  if (strlen(value.as<const char*>()) == 0U) {
+    return std::make_optional(std::optional<crypto::Aes::Array>{});
+  }
+  const auto parsed{parseKey(value.as<const char*>())};
+  if (not parsed) {
+    return std::nullopt;
+  }
+  return std::make_optional(parsed);
+}
+
+std::optional<std::vector<NodeKey>>
+parseNodeKeys(const JsonArrayConst array)
+{
+  std::vector<NodeKey> nodeKeys;
+  for (const auto entry : array) {
+    const auto keyId{entry["id"]};
+    const auto key{entry["key"]};
+    if (not keyId.is<crypto::KeyRing::KeyId>() or not key.is<const char*>()) {
+      return std::nullopt;
+    }
+
+    NodeKey nodeKey{keyId.as<crypto::KeyRing::KeyId>(), {}, std::nullopt};
+    const auto parsedKey{parseKey(key.as<const char*>())};
+    if (not parsedKey) {
+      return std::nullopt;
+    }
+    nodeKey.key = *parsedKey;
+
+    if (const auto previousKey{entry["key_previous"]}; not previousKey.isNull()) {
+      const auto parsed{parseOptionalKey(previousKey)};
+      if (not parsed) {
+        return std::nullopt;
+      }
+      nodeKey.previousKey = *parsed;
+    }
+    nodeKeys.push_back(nodeKey);
+  }
+  return nodeKeys;
+}
+
+bool
+isTopicSafe(const String& value)
+{
+  return std::all_of(value.c_str(), value.c_str() + value.length(), [](const char character) {
+    return std::isalnum(static_cast<unsigned char>(character)) or character == '_' or character == '-';
+  });
+}
+
+// Shared by decode() and applyJson(), a stored blob is not trusted more than an MQTT message.
+bool
+isValid(const GatewayConfig& config)
+{
+  for (const auto& field : g_stringFields) {
+    const String& value{config.*field.member};
+    if (value.length() < field.minLength or value.length() > field.maxLength or
+        (field.topicSafe and not isTopicSafe(value))) {
+      return false;
+    }
+  }
+
+  if (config.mqttPort == 0U or config.nodeKeys.size() > std::numeric_limits<std::uint8_t>::max()) {
+    return false;
+  }
+
+  // key ID 0 would replace the gateway key in makeKeyRing()
+  for (auto nodeKey{config.nodeKeys.begin()}; nodeKey != config.nodeKeys.end(); ++nodeKey) {
+    const bool duplicate{std::any_of(config.nodeKeys.begin(), nodeKey, [&nodeKey](const NodeKey& other) {
+      return other.keyId == nodeKey->keyId;
+    })};
+    if (nodeKey->keyId == g_defaultKeyId or duplicate) {
+      return false;
+    }
+  }
+  return true;
+}
+} // namespace
+
+bool
+NodeKey::operator==(const NodeKey& other) const
+{
+  return keyId == other.keyId and key == other.key and previousKey == other.previousKey;
+}
+
+bool
+GatewayConfig::operator==(const GatewayConfig& other) const
+{
+  for (const auto& field : g_stringFields) {
+    if (this->*field.member != other.*field.member) {
+      return false;
+    }
+  }
+  return mqttPort == other.mqttPort and aesKey == other.aesKey and previousAesKey == other.previousAesKey and
+         nodeKeys == other.nodeKeys;
+}
+
+bool
+GatewayConfig::operator!=(const GatewayConfig& other) const
+{
+  return not(*this == other);
+}
+
+bool
+requiresRestart(const GatewayConfig& current, const GatewayConfig& updated)
+{
+  for (const auto& field : g_stringFields) {
+    if (current.*field.member != updated.*field.member) {
+      return true;
+    }
+  }
+  return current.mqttPort != updated.mqttPort;
+}
+
+crypto::KeyRing
+makeKeyRing(const GatewayConfig& config)
+{
+  crypto::KeyRing keyRing;
+  keyRing.set(g_defaultKeyId, config.aesKey, config.previousAesKey);
+  for (const auto& nodeKey : config.nodeKeys) {
+    keyRing.set(nodeKey.keyId, nodeKey.key, nodeKey.previousKey);
+  }
+  return keyRing;
+}
+
+std::vector<std::uint8_t>
+encode(const GatewayConfig& config)
+{
+  std::vector<std::uint8_t> output;
+  output.push_back(g_layoutVersion);
+  output.push_back(config.previousAesKey ? g_flagPreviousAesKey : 0U);
+
+  for (const auto& field : g_stringFields) {
+    const String& value{config.*field.member};
+    output.push_back(static_cast<std::uint8_t>(value.length()));
+    output.insert(output.end(), value.c_str(), value.c_str() + value.length());
+  }
+
+  output.push_back(static_cast<std::uint8_t>(config.mqttPort & 0xFFU));
+  output.push_back(static_cast<std::uint8_t>(config.mqttPort >> 8U));
+  appendKeys(output, config.aesKey, config.previousAesKey);
+
+  output.push_back(static_cast<std::uint8_t>(config.nodeKeys.size()));
+  for (const auto& nodeKey : config.nodeKeys) {
+    output.push_back(nodeKey.keyId);
+    output.push_back(nodeKey.previousKey ? g_flagPreviousAesKey : 0U);
+    appendKeys(output, nodeKey.key, nodeKey.previousKey);
+  }
+
+  return output;
+}
+
+std::optional<GatewayConfig>
+decode(const std::uint8_t* const data, const std::size_t length)
+{
+  Reader reader{data, length};
+  const auto version{reader.readByte()};
+  if (version != g_layoutVersion and version != g_layoutVersionWithoutNodeKeys) {
+    return std::nullopt;
+  }
+  const auto flags{reader.readByte()};
+  if (not flags) {
+    return std::nullopt;
+  }
+
+  GatewayConfig config{};
+  for (const auto& field : g_stringFields) {
+    const auto fieldLength{reader.readByte()};
+    if (not fieldLength or *fieldLength < field.minLength or *fieldLength > field.maxLength) {
+      return std::nullopt;
+    }
+    char buffer[std::numeric_limits<std::uint8_t>::max()];
+    if (not reader.read(reinterpret_cast<std::uint8_t*>(buffer), *fieldLength)) {
+      return std::nullopt;
+    }
+    config.*field.member = String{buffer, *fieldLength};
+  }
+
+  std::uint8_t port[2];
+  if (not reader.read(port, sizeof(port)) or not readKeys(reader, *flags, config.aesKey, config.previousAesKey)) {
+    return std::nullopt;
+  }
+  config.mqttPort = static_cast<std::uint16_t>(port[0] | (port[1] << 8U));
+
+  if (version == g_layoutVersion) {
+    const auto count{reader.readByte()};
+    if (not count) {
+      return std::nullopt;
+    }
+    for (std::uint8_t index{0U}; index < *count; ++index) {
+      const auto keyId{reader.readByte()};
+      const auto keyFlags{reader.readByte()};
+      NodeKey nodeKey{};
+      if (not keyId or not keyFlags or not readKeys(reader, *keyFlags, nodeKey.key, nodeKey.previousKey)) {
+        return std::nullopt;
+      }
+      nodeKey.keyId = *keyId;
+      config.nodeKeys.push_back(nodeKey);
+    }
+  }
+
+  if (not reader.atEnd() or not isValid(config)) {
+    return std::nullopt;
+  }
+  return config;
+}
+
+std::optional<GatewayConfig>
+applyJson(const GatewayConfig& current, const char* const payload)
+{
+  JsonDocument doc;
+  if (deserializeJson(doc, payload) or not doc.is<JsonObject>()) {
+    return std::nullopt;
+  }
+
+  GatewayConfig updated{current};
+  for (const auto& field : g_stringFields) {
+    const auto value{doc[field.jsonKey]};
+    if (value.isNull()) {
+      continue;
+    }
+    if (not value.is<const char*>()) {
+      return std::nullopt;
+    }
+    updated.*field.member = value.as<const char*>();
+  }
+
+  if (const auto port{doc["mqtt_port"]}; not port.isNull()) {
+    if (not port.is<std::uint16_t>()) {
+      return std::nullopt;
+    }
+    updated.mqttPort = port.as<std::uint16_t>();
+  }
+
+  if (const auto key{doc["aes_key"]}; not key.isNull()) {
+    const auto parsed{key.is<const char*>() ? parseKey(key.as<const char*>()) : std::nullopt};
+    if (not parsed) {
+      return std::nullopt;
+    }
+    updated.aesKey = *parsed;
+  }
+
+  if (const auto key{doc["aes_key_previous"]}; not key.isNull()) {
+    const auto parsed{parseOptionalKey(key)};
+    if (not parsed) {
+      return std::nullopt;
+    }
+    updated.previousAesKey = *parsed;
+  }
+
+  if (const auto nodeKeys{doc["node_keys"]}; not nodeKeys.isNull()) {
+    auto parsed{nodeKeys.is<JsonArrayConst>() ? parseNodeKeys(nodeKeys.as<JsonArrayConst>()) : std::nullopt};
+    if (not parsed) {
+      return std::nullopt;
+    }
+    updated.nodeKeys = std::move(*parsed);
+  }
+
+  if (not isValid(updated)) {
+    return std::nullopt;
+  }
+  return updated;
+}
+} // namespace config
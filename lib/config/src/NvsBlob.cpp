@@ -0,0 +1,56 @@
+#include <config/NvsBlob.h>
+
+#include <Preferences.h>
+
+#include <logging/Log.h>
+
+namespace config {
+std::vector<std::uint8_t>
+loadBlob(const char* const nvsNamespace, const char* const key)
+{
+  Preferences preferences;
+  if (not preferences.begin(nvsNamespace, true)) {
+    return {}; // namespace does not exist before the first save
+  }
+
+  std::vector<std::uint8_t> buffer(preferences.getBytesLength(key));
+  const auto length{buffer.empty() ? 0U : preferences.getBytes(key, buffer.data(), buffer.size())};
+  preferences.end();
+
+  buffer.resize(length);
+  return buffer;
+}
+
+bool
+saveBlob(const char* const nvsNamespace, const char* const key, const std::vector<std::uint8_t>& data)
+{
+  Preferences preferences;
+  if (not preferences.begin(nvsNamespace, false)) {
+    LOG_ERROR("Failed to open storage", nvsNamespace);
+    return false;
+  }
+
+  // NVS keeps the old blob until the new one is completely written
+  const bool saved{preferences.putBytes(key, data.data(), data.size()) == data.size()};
+  preferences.end();
+
+  if (not saved) {
+    LOG_ERROR("Failed to save", key);
+  }
+  return saved;
+}
+
+void
+removeBlob(const char* const nvsNamespace, const char* const key)
+{
+  Preferences preferences;
+  if (not preferences.begin(nvsNamespace, false)) {
+    LOG_ERROR("Failed to open storage", nvsNamespace);
+    return;
+  }
+  if (preferences.isKey(key)) {
+    preferences.remove(key);
+  }
+  preferences.end();
+}
+} // namespace config
@@ -4,10 +4,12 @@
 #include <stdint.h>
 
 #include <array>
+#include <optional>
 
 #include <Arduino.h>
 
 #include <AESLib.h>
+#include <mbedtls/aes.h>
 
 namespace crypto {
 class Aes
@@ -15,15 +17,35 @@ class Aes
 public:
   using Array = std::array<byte, N_BLOCK>;
 
-  explicit Aes(const Array& key, paddingMode paddingMode = paddingMode::CMS) noexcept;
+  // During a key rotation the previous key stays usable for decryption only.
+  enum class KeySlot : uint8_t
+  {
+    Current,
+    Previous,
+  };
+
+  explicit Aes(const Array& key,
+               const std::optional<Array>& previousKey = std::nullopt,
+               paddingMode paddingMode = paddingMode::CMS) noexcept;
+  Aes(const Aes&) = delete;
+  Aes& operator=(const Aes&) = delete;
+  ~Aes();
+
+  void setKeys(const Array& key, const std::optional<Array>& previousKey);
+  [[nodiscard]] bool hasPreviousKey() const;
   uint16_t encrypt(const byte* input, uint16_t length, byte* output);
   uint16_t encrypt(const char* input, uint16_t length, char* output);
-  uint16_t decrypt(byte* input, uint16_t length, byte* output);
-  uint16_t decrypt(char* input, uint16_t length, char* output);
+  uint16_t decrypt(byte* input, uint16_t length, byte* output, KeySlot slot = KeySlot::Current);
+  uint16_t decrypt(char* input, uint16_t length, char* output, KeySlot slot = KeySlot::Current);
   size_t calculateEncryptedLength(int16_t length);
 
 private:
   AESLib m_aesLib;
+  paddingMode m_paddingMode;
   Array m_key;
+  std::optional<Array> m_previousKey;
+  // decryption key schedules, expanded once per key instead of once per packet
+  mbedtls_aes_context m_decryptContext;
+  mbedtls_aes_context m_previousDecryptContext;
 };
 } // namespace crypto
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <array>
+#include <limits>
+#include <memory>
+#include <optional>
+
+#include <crypto/Aes.hpp>
+
+namespace crypto {
+// Ciphers indexed by the cleartext key ID of a packet, so every node (or tenant) can have its own key.
+class KeyRing
+{
+public:
+  using KeyId = uint8_t;
+
+  void set(KeyId keyId, const Aes::Array& key, const std::optional<Aes::Array>& previousKey = std::nullopt);
+  void remove(KeyId keyId);
+  // constant time, nullptr for unknown key IDs
+  [[nodiscard]] Aes* find(KeyId keyId) const;
+
+private:
+  std::array<std::unique_ptr<Aes>, std::numeric_limits<KeyId>::max() + 1U> m_ciphers;
+};
+} // namespace crypto
@@ -13,12 +13,61 @@ fillIv(Aes::Array& aesIv)
     return static_cast<ValueType>(random(std::numeric_limits<ValueType>::min(), std::numeric_limits<ValueType>::max()));
   });
 }
+
+void
+setDecryptionKey(mbedtls_aes_context& context, const Aes::Array& key)
+{
+  mbedtls_aes_setkey_dec(&context, key.data(), static_cast<unsigned int>(key.size() * 8U));
+}
+
+// Returns the unpadded length or 0 if the CMS (PKCS#7) padding is invalid, which usually means a wrong key.
+uint16_t
+removeCmsPadding(const byte* const data, const uint16_t length)
+{
+  const byte padding{data[length - 1U]};
+  if (padding == 0U or padding > N_BLOCK) {
+    return 0U;
+  }
+  const bool valid{std::all_of(data + length - padding, data + length, [padding](const byte value) {
+    return value == padding;
+  })};
+  return valid ? length - padding : 0U;
+}
 } // namespace
 
-Aes::Aes(const Array& key, const paddingMode paddingMode) noexcept
-  : m_key{key}
+Aes::Aes(const Array& key, const std::optional<Array>& previousKey, const paddingMode paddingMode) noexcept
+  : m_paddingMode{paddingMode}
+  , m_key{}
+  , m_decryptContext{}
+  , m_previousDecryptContext{}
 {
   m_aesLib.set_paddingmode(paddingMode);
+  mbedtls_aes_init(&m_decryptContext);
+  mbedtls_aes_init(&m_previousDecryptContext);
+  setKeys(key, previousKey);
+}
+
+Aes::~Aes()
+{
+  mbedtls_aes_free(&m_decryptContext);
+  mbedtls_aes_free(&m_previousDecryptContext);
+}
+
+void
+Aes::setKeys(const Array& key, const std::optional<Array>& previousKey)
+{
+  m_key = key;
+  m_previousKey = previousKey;
+  setDecryptionKey(m_decryptContext, m_key);
+  if (m_previousKey) {
+    setDecryptionKey(m_previousDecryptContext, *m_previousKey);
+  }
+}
+
+bool
+Aes::hasPreviousKey() const
+{
+  return m_previousKey.has_value();
 }
 
 uint16_t
@@ -39,22 +88,40 @@ Aes::encrypt(const char* input, const uint16_t length, char* const output)
 }
 
 uint16_t
-Aes::decrypt(byte* const input, const uint16_t length, byte* const output)
+Aes::decrypt(byte* const input, const uint16_t length, byte* const output, const KeySlot slot)
 {
   Array aesIv;
   if (length < aesIv.size()) {
     return 0; // Not enough data for IV
   }
+  if (slot == KeySlot::Previous and not m_previousKey) {
+    return 0;
+  }
   memcpy(aesIv.data(), input, aesIv.size());
 
-  return m_aesLib.decrypt(
-    input + aesIv.size(), length - aesIv.size(), output, m_key.data(), sizeof(m_key), aesIv.data());
+  if (m_paddingMode != paddingMode::CMS) {
+    const Array& key{slot == KeySlot::Previous ? *m_previousKey : m_key};
+    return m_aesLib.decrypt(
+      input + aesIv.size(), length - aesIv.size(), output, key.data(), sizeof(key), aesIv.data());
+  }
+
+  const auto cipherLength{static_cast<uint16_t>(length - aesIv.size())};
+  if (cipherLength == 0U or cipherLength % N_BLOCK != 0U) {
+    return 0;
+  }
+
+  auto& context{slot == KeySlot::Previous ? m_previousDecryptContext : m_decryptContext};
+  if (mbedtls_aes_crypt_cbc(&context, MBEDTLS_AES_DECRYPT, cipherLength, aesIv.data(), input + aesIv.size(), output) !=
+      0) {
+    return 0;
+  }
+  return removeCmsPadding(output, cipherLength);
 }
 
 uint16_t
-Aes::decrypt(char* const input, const uint16_t length, char* const output)
+Aes::decrypt(char* const input, const uint16_t length, char* const output, const KeySlot slot)
 {
-  return decrypt(reinterpret_cast<byte*>(input), length, reinterpret_cast<byte*>(output));
+  return decrypt(reinterpret_cast<byte*>(input), length, reinterpret_cast<byte*>(output), slot);
 }
 
 size_t
@@ -0,0 +1,25 @@
+#include <crypto/KeyRing.hpp>
+
+namespace crypto {
+void
+KeyRing::set(const KeyId keyId, const Aes::Array& key, const std::optional<Aes::Array>& previousKey)
+{
+  if (auto& cipher{m_ciphers[keyId]}) {
+    cipher->setKeys(key, previousKey);
+  } else {
+    cipher = std::make_unique<Aes>(key, previousKey);
+  }
+}
+
+void
+KeyRing::remove(const KeyId keyId)
+{
+  m_ciphers[keyId].reset();
+}
+
+Aes*
+KeyRing::find(const KeyId keyId) const
+{
+  return m_ciphers[keyId].get();
+}
+} // namespace crypto
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Compile time log level, everything above it compiles to nothing: 0 off, 1 error, 2 warning, 3 info, 4 debug
+#ifndef LOG_LEVEL
+#define LOG_LEVEL 3
+#endif
+
+namespace logging {
+enum class Level : uint8_t
+{
+  Error = 1,
+  Warning = 2,
+  Info = 3,
+  Debug = 4,
+};
+
+// Binary log record, formatted by the drain task. The message must be a string literal.
+struct Record
+{
+  static constexpr std::size_t textSize{48U};
+
+  uint32_t timestampMs;
+  const char* message;
+  int32_t value;
+  uint16_t suppressed;
+  Level level;
+  bool hasValue;
+  char text[textSize]; // truncated copy, empty if unused
+};
+
+// Lets one record per interval through and counts the suppressed ones. Meant for a single call site.
+class RateLimiter
+{
+public:
+  static constexpr uint32_t intervalMs{10'000U};
+
+  bool allow(uint16_t& suppressed);
+
+private:
+  std::atomic<uint32_t> m_nextMs{0U};
+  std::atomic<uint16_t> m_suppressed{0U};
+  std::atomic<bool> m_started{false};
+};
+
+// Number of records a rate limiter swallowed before this one.
+struct Suppressed
+{
+  uint16_t count;
+};
+
+// Enqueue without blocking, records are dropped (and counted) if the queue is full.
+void log(Level level, const char* message, Suppressed suppressed = {0U});
+void log(Level level, const char* message, int32_t value, Suppressed suppressed = {0U});
+void log(Level level, const char* message, const char* text, Suppressed suppressed = {0U});
+
+// Starts the low priority task that writes queued records to Serial.
+void startDrainTask();
+// Writes all queued records from the calling task, e.g. before a restart or sleep.
+void flush();
+} // namespace logging
+
+// NOLINTBEGIN(cppcoreguidelines-macro-usage)
+
+#define LOGGING_LOG(levelValue, level, ...)                                                                            \
+  do {                                                                                                                 \
+    if constexpr (LOG_LEVEL >= (levelValue)) {                                                                         \
+      ::logging::log(level, __VA_ARGS__);                                                                              \
+    }                                                                                                                  \
+  } while (false)
+
+#define LOGGING_LOG_RATE_LIMITED(levelValue, level, ...)                                                              \
+  do {                                                                                                                 \
+    if constexpr (LOG_LEVEL >= (levelValue)) {                                                                         \
+      static ::logging::RateLimiter logRateLimiter;                                                                    \
+      if (uint16_t logSuppressed{0U}; logRateLimiter.allow(logSuppressed)) {                                          \
+        ::logging::log(level, __VA_ARGS__, ::logging::Suppressed{logSuppressed});                                      \
+      }                                                                                                                \
+    }                                                                                                                  \
+  } while (false)
+
+#define LOG_ERROR(...) LOGGING_LOG(1, ::logging::Level::Error, __VA_ARGS__)
+#define LOG_WARNING(...) LOGGING_LOG(2, ::logging::Level::Warning, __VA_ARGS__)
+#define LOG_INFO(...) LOGGING_LOG(3, ::logging::Level::Info, __VA_ARGS__)
+#define LOG_DEBUG(...) LOGGING_LOG(4, ::logging::Level::Debug, __VA_ARGS__)
+
+#define LOG_ERROR_RATE_LIMITED(...) LOGGING_LOG_RATE_LIMITED(1, ::logging::Level::Error, __VA_ARGS__)
+#define LOG_WARNING_RATE_LIMITED(...) LOGGING_LOG_RATE_LIMITED(2, ::logging::Level::Warning, __VA_ARGS__)
+
+// NOLINTEND(cppcoreguidelines-macro-usage)
@@ -0,0 +1,224 @@
+#include <logging/Log.h>
+
+#include <array>
+#include <cstring>
+#include <mutex>
+
+#include <Arduino.h>
+
+namespace logging {
+namespace {
+constexpr std::size_t g_queueSize{64U}; // power of two
+constexpr uint32_t g_drainTaskStackSize{3072U};
+constexpr UBaseType_t g_drainTaskPriority{tskIDLE_PRIORITY + 1U};
+constexpr TickType_t g_drainInterval{pdMS_TO_TICKS(20)};
+
+static_assert((g_queueSize & (g_queueSize - 1U)) == 0U, "queue size must be a power of two");
+
+// Bounded lock-free multi producer/multi consumer queue (D. Vyukov). Every cell carries a sequence number that
+// tells producers and consumers whether it is free for the current lap.
+class RecordQueue
+{
+public:
+  RecordQueue() noexcept
+  {
+    for (std::size_t index{0U}; index < g_queueSize; ++index) {
+      m_cells[index].sequence.store(index, std::memory_order_relaxed);
+    }
+  }
+
+  template<typename TFill>
+  bool push(TFill&& fill)
+  {
+    std::size_t position{m_enqueuePosition.load(std::memory_order_relaxed)};
+    while (true) {
+      Cell& cell{m_cells[position & (g_queueSize - 1U)]};
+      const std::size_t sequence{cell.sequence.load(std::memory_order_acquire)};
+      const auto difference{static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position)};
+      if (difference == 0) {
+        if (m_enqueuePosition.compare_exchange_weak(position, position + 1U, std::memory_order_relaxed)) {
+          fill(cell.record);
+          cell.sequence.store(position + 1U, std::memory_order_release);
+          return true;
+        }
+      } else if (difference < 0) {
+        return false; // full
+      } else {
+        position = m_enqueuePosition.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool pop(Record& record)
+  {
+    std::size_t position{m_dequeuePosition.load(std::memory_order_relaxed)};
+    while (true) {
+      Cell& cell{m_cells[position & (g_queueSize - 1U)]};
+      const std::size_t sequence{cell.sequence.load(std::memory_order_acquire)};
+      const auto difference{static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position + 1U)};
+      if (difference == 0) {
+        if (m_dequeuePosition.compare_exchange_weak(position, position + 1U, std::memory_order_relaxed)) {
+          record = cell.record;
+          cell.sequence.store(position + g_queueSize, std::memory_order_release);
+          return true;
+        }
+      } else if (difference < 0) {
+        return false; // empty
+      } else {
+        position = m_dequeuePosition.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+private:
+  struct Cell
+  {
+    std::atomic<std::size_t> sequence;
+    Record record;
+  };
+
+  std::array<Cell, g_queueSize> m_cells{};
+  std::atomic<std::size_t> m_enqueuePosition{0U};
+  std::atomic<std::size_t> m_dequeuePosition{0U};
+};
+
+// NOLINTBEGIN(*-avoid-non-const-global-variables)
+
+RecordQueue g_queue;
+std::atomic<uint32_t> g_dropped{0U};
+// held while writing, so flush() and the drain task neither interleave the parts of a record nor reorder records
+std::mutex g_writeMutex;
+
+// NOLINTEND(*-avoid-non-const-global-variables)
+
+void
+enqueue(const Level level,
+        const char* const message,
+        const int32_t* const value,
+        const char* const text,
+        const Suppressed suppressed)
+{
+  const bool pushed{g_queue.push([&](Record& record) {
+    record.timestampMs = millis();
+    record.message = message;
+    record.value = value != nullptr ? *value : 0;
+    record.suppressed = suppressed.count;
+    record.level = level;
+    record.hasValue = value != nullptr;
+    if (text != nullptr) {
+      strncpy(record.text, text, Record::textSize - 1U);
+      record.text[Record::textSize - 1U] = '\0';
+    } else {
+      record.text[0] = '\0';
+    }
+  })};
+
+  if (not pushed) {
+    g_dropped.fetch_add(1U, std::memory_order_relaxed);
+  }
+}
+
+char
+levelCharacter(const Level level)
+{
+  switch (level) {
+    case Level::Error:
+      return 'E';
+    case Level::Warning:
+      return 'W';
+    case Level::Info:
+      return 'I';
+    case Level::Debug:
+      return 'D';
+  }
+  return '?';
+}
+
+void
+write(const Record& record)
+{
+  Serial.printf(
+    "[%10lu] %c %s", static_cast<unsigned long>(record.timestampMs), levelCharacter(record.level), record.message);
+  if (record.hasValue) {
+    Serial.printf(": %ld", static_cast<long>(record.value));
+  }
+  if (record.text[0] != '\0') {
+    Serial.printf(": %s", record.text);
+  }
+  if (record.suppressed > 0U) {
+    Serial.printf(" (%u suppressed)", static_cast<unsigned>(record.suppressed));
+  }
+  Serial.println();
+}
+
+void
+drain()
+{
+  const std::lock_guard lock{g_writeMutex};
+  Record record{};
+  while (g_queue.pop(record)) {
+    write(record);
+  }
+
+  if (const auto dropped{g_dropped.exchange(0U, std::memory_order_relaxed)}; dropped > 0U) {
+    Serial.printf("%lu log records dropped\n", static_cast<unsigned long>(dropped));
+  }
+}
+
+void
+drainTask(void*)
+{
+  while (true) {
+    drain();
+    vTaskDelay(g_drainInterval);
+  }
+}
+} // namespace
+
+bool
+RateLimiter::allow(uint16_t& suppressed)
+{
+  const auto now{static_cast<uint32_t>(millis())};
+  if (m_started.load(std::memory_order_relaxed) and
+      static_cast<int32_t>(now - m_nextMs.load(std::memory_order_relaxed)) < 0) {
+    m_suppressed.fetch_add(1U, std::memory_order_relaxed);
+    return false;
+  }
+
+  m_started.store(true, std::memory_order_relaxed);
+  m_nextMs.store(now + intervalMs, std::memory_order_relaxed);
+  suppressed = m_suppressed.exchange(0U, std::memory_order_relaxed);
+  return true;
+}
+
+void
+log(const Level level, const char* const message, const Suppressed suppressed)
+{
+  enqueue(level, message, nullptr, nullptr, suppressed);
+}
+
+void
+log(const Level level, const char* const message, const int32_t value, const Suppressed suppressed)
+{
+  enqueue(level, message, &value, nullptr, suppressed);
+}
+
+void
+log(const Level level, const char* const message, const char* const text, const Suppressed suppressed)
+{
+  enqueue(level, message, nullptr, text, suppressed);
+}
+
+void
+startDrainTask()
+{
+  xTaskCreate(drainTask, "log", g_drainTaskStackSize, nullptr, g_drainTaskPriority, nullptr);
+}
+
+void
+flush()
+{
+  drain();
+  Serial.flush();
+}
+} // namespace logging
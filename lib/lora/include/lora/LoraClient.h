@@ -2,11 +2,16 @@
 
 #include <Arduino.h>
 
+#include <cstddef>
 #include <optional>
 
 #include <RadioLib.h>
 
-#include <crypto/Aes.hpp>
+#include <airtime/Airtime.h>
+#include <airtime/DutyCycleAccountant.h>
+#include <crypto/KeyRing.hpp>
+#include <packet/Packet.h>
+#include <packet/PacketDecoder.h>
 
 namespace lora {
 class LoraClient
@@ -14,18 +19,38 @@ class LoraClient
 public:
   using PacketReceivedAction = void (*)();
 
-  explicit LoraClient(const crypto::Aes::Array& key) noexcept;
+  // SX126x FIFO size, all receive buffers are fixed to it
+  static constexpr std::size_t maxPacketLength{RADIOLIB_SX126X_MAX_PACKET_LENGTH};
+  static_assert(maxPacketLength <= packet::PacketDecoder::maxPacketLength);
+
+  LoraClient(crypto::KeyRing keyRing, String gatewayId) noexcept;
 
   bool begin();
   bool startReceive();
-  std::optional<String> receiveMessage();
+  // Sleeps between preamble sniffs, senders need a preamble long enough to span a sleep period.
+  bool startReceiveDutyCycle(uint16_t senderPreambleLength);
+  std::optional<packet::Packet> receiveMessage(int64_t receivedAtUs);
+  void setKeyRing(crypto::KeyRing keyRing);
   void setPacketReceivedAction(PacketReceivedAction callback);
-  int getRssi();
   int32_t randomInt();
+  [[nodiscard]] uint8_t interruptPin() const;
+  [[nodiscard]] float frequencyMhz() const;
+  [[nodiscard]] static airtime::Modulation modulation();
+  // airtime of every received packet, including the ones that could not be decrypted
+  [[nodiscard]] const airtime::DutyCycleAccountant& channelAirtime() const;
+  // Airtime of the own transmissions, kept apart from the received traffic which must not use up the transmit
+  // budget of the sub-band.
+  [[nodiscard]] const airtime::DutyCycleAccountant& transmitAirtime() const;
+  [[nodiscard]] bool canTransmit(std::size_t length) const;
+  // Sends if the duty cycle budget allows it. Blocks until sent and leaves the radio in standby, receiving has to be
+  // restarted afterwards.
+  bool transmit(const byte* data, std::size_t length);
 
 private:
-  crypto::Aes m_cipher;
+  packet::PacketDecoder m_decoder;
   Module m_module;
   SX1262 m_lora;
+  airtime::DutyCycleAccountant m_channelAirtime;
+  airtime::DutyCycleAccountant m_transmitAirtime;
 };
 } // namespace lora
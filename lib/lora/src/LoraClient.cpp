@@ -1,12 +1,13 @@
 #include <lora/LoraClient.h>
 
-#include <algorithm>
-#include <cctype>
+#include <array>
 #include <limits>
-#include <vector>
+#include <utility>
 
 #include <SPI.h>
 
+#include <logging/Log.h>
+
 namespace lora {
 namespace {
 constexpr uint8_t g_spiSckPin{5U};
@@ -19,28 +20,17 @@ constexpr uint8_t g_radioResetPin{8U};
 constexpr uint8_t g_radioBusyPin{34U};
 
 constexpr float g_loraFrequency{868.0F};
-constexpr float g_bandwidth{125.0F};
-constexpr uint8_t g_spreadingFactor{8U};
-constexpr uint8_t g_codingRate{5U};
+constexpr float g_bandwidth{airtime::g_gatewayModulation.bandwidthKhz};
+constexpr uint8_t g_spreadingFactor{airtime::g_gatewayModulation.spreadingFactor};
+constexpr uint8_t g_codingRate{airtime::g_gatewayModulation.codingRate};
 constexpr uint8_t g_syncWord{RADIOLIB_SX126X_SYNC_WORD_PRIVATE};
 constexpr uint8_t g_power{20U};
-constexpr uint16_t g_preambleLength{6U};
+constexpr uint16_t g_preambleLength{airtime::g_gatewayModulation.preambleLength};
 constexpr float g_txcoVoltage{1.6F};
-
-std::optional<String>
-toString(const char* const array, const std::size_t length)
-{
-  const bool isPrintable{std::all_of(array, array + length, [](const char character) {
-    return std::isprint(character);
-  })};
-
-  return isPrintable ? std::make_optional(String{array, length}) : std::nullopt;
-}
-
 } // namespace
 
-LoraClient::LoraClient(const crypto::Aes::Array& key) noexcept
-  : m_cipher{key}
+LoraClient::LoraClient(crypto::KeyRing keyRing, String gatewayId) noexcept
+  : m_decoder{std::move(keyRing), std::move(gatewayId)}
   , m_module{g_radioNssPin, g_radioDio1Pin, g_radioResetPin, g_radioBusyPin, SPI}
   , m_lora{&m_module}
 {
@@ -59,26 +49,22 @@ LoraClient::begin()
                                     g_preambleLength,
                                     g_txcoVoltage)};
       state != RADIOLIB_ERR_NONE) {
-    Serial.print(F("LoRa begin failed, code: "));
-    Serial.println(state);
+    LOG_ERROR("LoRa begin failed", state);
     return false;
   }
 
   if (const auto state{m_lora.setCRC(true)}; state != RADIOLIB_ERR_NONE) {
-    Serial.print(F("Failed to set CRC, code: "));
-    Serial.println(state);
+    LOG_ERROR("Failed to set CRC", state);
     return false;
   }
 
   if (const auto state{m_lora.invertIQ(false)}; state != RADIOLIB_ERR_NONE) {
-    Serial.print(F("Failed to set invert IQ, code: "));
-    Serial.println(state);
+    LOG_ERROR("Failed to set invert IQ", state);
     return false;
   }
 
   if (const auto state{m_lora.explicitHeader()}; state != RADIOLIB_ERR_NONE) {
-    Serial.print(F("Failed to set explicit header, code: "));
-    Serial.println(state);
+    LOG_ERROR("Failed to set explicit header", state);
     return false;
   }
 
@@ -89,56 +75,66 @@ bool
 LoraClient::startReceive()
 {
   if (const auto state{m_lora.startReceive()}; state != RADIOLIB_ERR_NONE) {
-    Serial.print(F("Failed to start receive, code: "));
-    Serial.println(state);
+    LOG_ERROR("Failed to start receive", state);
+    return false;
+  }
+
+  return true;
+}
+
+bool
+LoraClient::startReceiveDutyCycle(const uint16_t senderPreambleLength)
+{
+  if (const auto state{m_lora.startReceiveDutyCycleAuto(senderPreambleLength)}; state != RADIOLIB_ERR_NONE) {
+    LOG_ERROR("Failed to start duty cycled receive", state);
     return false;
   }
 
   return true;
 }
 
-std::optional<String>
-LoraClient::receiveMessage()
+std::optional<packet::Packet>
+LoraClient::receiveMessage(const int64_t receivedAtUs)
 {
   const auto packetLength{m_lora.getPacketLength()};
   if (packetLength == 0) {
     return std::nullopt;
   }
 
-  std::vector<byte> receiveBuffer(packetLength);
-  if (const auto state{m_lora.readData(receiveBuffer.data(), receiveBuffer.size())}; state != RADIOLIB_ERR_NONE) {
-    Serial.print(F("Failed to read data, code: "));
-    Serial.println(state);
+  // sample the packet status before anything else, it is overwritten by the next packet
+  const packet::PacketMetadata metadata{
+    .rssi = m_lora.getRSSI(),
+    .snr = m_lora.getSNR(),
+    .frequencyError = m_lora.getFrequencyError(),
+    .timestampUs = receivedAtUs,
+    .airtimeUs = airtime::timeOnAirUs(modulation(), packetLength),
+  };
+  m_channelAirtime.record(g_loraFrequency, metadata.airtimeUs, millis());
+
+  if (packetLength > maxPacketLength) {
+    LOG_WARNING_RATE_LIMITED("Packet too long", static_cast<int32_t>(packetLength));
     return std::nullopt;
   }
 
-  std::vector<byte> decryptedMessageBuffer(receiveBuffer.size());
-  const auto decryptedSize{m_cipher.decrypt(receiveBuffer.data(), receiveBuffer.size(), decryptedMessageBuffer.data())};
-
-  if (decryptedSize == 0 or decryptedSize > packetLength) {
-    Serial.println(F("Failed to decrypt data"));
+  std::array<byte, maxPacketLength> receiveBuffer;
+  if (const auto state{m_lora.readData(receiveBuffer.data(), packetLength)}; state != RADIOLIB_ERR_NONE) {
+    LOG_ERROR("Failed to read data", state);
     return std::nullopt;
   }
 
-  const auto string{toString(reinterpret_cast<const char*>(decryptedMessageBuffer.data()), decryptedSize)};
-
-  if (not string) {
-    Serial.println(F("Failed to decrypt data"));
-  }
-
-  return string;
+  return m_decoder.decode(receiveBuffer.data(), packetLength, metadata);
 }
 
 void
-LoraClient::setPacketReceivedAction(const PacketReceivedAction callback)
+LoraClient::setKeyRing(crypto::KeyRing keyRing)
 {
-  m_lora.setPacketReceivedAction(callback);
+  m_decoder.setKeyRing(std::move(keyRing));
 }
 
-int
-LoraClient::getRssi()
+void
+LoraClient::setPacketReceivedAction(const PacketReceivedAction callback)
 {
-  return static_cast<int>(m_lora.getRSSI());
+  m_lora.setPacketReceivedAction(callback);
 }
 
 int32_t
@@ -146,4 +142,57 @@ LoraClient::randomInt()
 {
   return m_lora.random(std::numeric_limits<int32_t>::max());
 }
+
+uint8_t
+LoraClient::interruptPin() const
+{
+  return g_radioDio1Pin;
+}
+
+float
+LoraClient::frequencyMhz() const
+{
+  return g_loraFrequency;
+}
+
+airtime::Modulation
+LoraClient::modulation()
+{
+  return airtime::g_gatewayModulation;
+}
+
+const airtime::DutyCycleAccountant&
+LoraClient::channelAirtime() const
+{
+  return m_channelAirtime;
+}
+
+const airtime::DutyCycleAccountant&
+LoraClient::transmitAirtime() const
+{
+  return m_transmitAirtime;
+}
+
+bool
+LoraClient::canTransmit(const std::size_t length) const
+{
+  return m_transmitAirtime.canTransmit(g_loraFrequency, airtime::timeOnAirUs(modulation(), length), millis());
+}
+
+bool
+LoraClient::transmit(const byte* const data, const std::size_t length)
+{
+  if (not canTransmit(length)) {
+    LOG_WARNING_RATE_LIMITED("Duty cycle limit reached");
+    return false;
+  }
+
+  if (const auto state{m_lora.transmit(data, length)}; state != RADIOLIB_ERR_NONE) {
+    LOG_ERROR("Failed to transmit", state);
+    return false;
+  }
+  m_transmitAirtime.record(g_loraFrequency, airtime::timeOnAirUs(modulation(), length), millis());
+  return true;
+}
+
 } // namespace lora
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include <ArduinoJson.h>
+
+#include <packet/Packet.h>
+
+namespace message {
+enum class DiscoveryMode : uint8_t
+{
+  PerEntity, // one retained config message per sensor key
+  PerDevice, // one retained config message per node covering all keys it has reported so far
+};
+
+enum class StateMode : uint8_t
+{
+  PerKey,     // one topic per sensor key
+  Aggregated, // one JSON document per node and packet, entities extract their field with a value template
+};
+
+struct ProcessorOptions
+{
+  bool publishLinkDiagnostics{false};
+  DiscoveryMode discoveryMode{DiscoveryMode::PerEntity};
+  StateMode stateMode{StateMode::PerKey};
+};
+
+// Topics and payloads for the keys a node can report. Keys are addressed by their index in the discovery info
+// table, bit n of a KeyMask is set if key n has been reported.
+using KeyMask = uint32_t;
+constexpr std::size_t g_maxDiscoveryInfos{sizeof(KeyMask) * 8U};
+
+enum class ValueType : uint8_t
+{
+  Integer,
+  Float,
+  String,
+};
+
+std::size_t discoveryInfoCount();
+const char* discoveryKey(std::size_t index);
+ValueType discoveryValueType(std::size_t index);
+// gateway keys, e.g. link diagnostics, are set by the gateway and dropped from node packets
+bool isGatewayKey(std::size_t index);
+
+// Parses a packet into a flat document with the known keys only. Returns false if the packet is malformed, has no
+// valid node ID or is meant for another gateway.
+bool decodeNodeMessage(const String& message, const String& gatewayId, JsonDocument& doc);
+// sets the RSSI and, if enabled, the other link diagnostics of the packet, disabled ones are removed
+void addMetadata(JsonDocument& doc, const packet::PacketMetadata& metadata, bool publishLinkDiagnostics);
+
+std::optional<String> stateValue(const JsonDocument& doc, std::size_t index);
+String stateTopic(std::size_t index, const String& nodeId);
+// copies all known values into the aggregated state document and returns the copied keys
+KeyMask copyState(const JsonDocument& doc, JsonDocument& state);
+String aggregatedStateTopic(const String& nodeId);
+
+String entityDiscoveryTopic(std::size_t index, const String& nodeId);
+void fillEntityDiscovery(JsonDocument& json, std::size_t index, const String& nodeId, StateMode stateMode);
+String deviceDiscoveryTopic(const String& nodeId);
+void fillDeviceDiscovery(JsonDocument& json, const String& nodeId, KeyMask keys, StateMode stateMode);
+} // namespace message
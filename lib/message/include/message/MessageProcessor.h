@@ -2,27 +2,231 @@
 
 #include <Arduino.h>
 
-#include <functional>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <utility>
 
 #include <ArduinoJson.h>
 
+#include <logging/Log.h>
+#include <message/HomeAssistant.h>
+
 namespace message {
+struct ProcessorStatistics
+{
+  uint32_t packets{0U};
+  uint32_t publishes{0U};
+  uint32_t publishedBytes{0U}; // topics and payloads
+};
+
+// Publishes node values and their Home Assistant discovery. Every MQTT message goes to the sink, called as
+// bool(const char* topic, const char* payload, std::size_t payloadLength, bool retained). The sink type is a
+// template parameter instead of a std::function, so the calls are resolved at compile time and can be inlined.
+template<typename TSink>
 class MessageProcessor
 {
 public:
-  using PublishCallback = std::function<bool(const String& topic, const String& payload, bool retained)>;
-  using RssiCallback = std::function<int()>;
+  // nodes whose device discovery keys are tracked, the least recently heard one is forgotten for a new one
+  static constexpr std::size_t maxDiscoveredNodes{256U};
+
+  MessageProcessor(TSink sink, String gatewayId, const ProcessorOptions options = {}) noexcept
+    : m_sink{std::move(sink)}
+    , m_gatewayId{std::move(gatewayId)}
+    , m_options{options}
+  {
+  }
+
+  // publishes gateway level values (same keys as node values) under the gateway ID as node ID
+  void publishGatewayDiagnostics(JsonDocument& doc)
+  {
+    doc["id"] = m_gatewayId;
+    publishUpdate(doc);
+  }
+
+  // publishes a document produced by decodeNodeMessage(), received packets get here through the Publisher stage
+  void publishUpdate(const JsonDocument& doc)
+  {
+    ++m_statistics.packets;
+    if (m_options.stateMode == StateMode::Aggregated) {
+      publishAggregatedUpdate(doc);
+      return;
+    }
+
+    const auto identifier{doc["id"].as<String>()};
+
+    std::array<std::optional<String>, g_maxDiscoveryInfos> payloads;
+    KeyMask reportedKeys{0U};
+    for (std::size_t index{0U}; index < discoveryInfoCount(); ++index) {
+      auto payload{stateValue(doc, index)};
+      if (not payload.has_value() or payload->isEmpty()) {
+        continue;
+      }
+      payloads[index] = std::move(payload);
+      reportedKeys |= KeyMask{1U} << index;
+    }
+
+    if (reportedKeys == 0U) {
+      return;
+    }
+    publishDiscovery(identifier, reportedKeys);
+
+    for (std::size_t index{0U}; index < discoveryInfoCount(); ++index) {
+      if (payloads[index]) {
+        publish(stateTopic(index, identifier), payloads[index]->c_str(), payloads[index]->length());
+      }
+    }
+  }
+
+  [[nodiscard]] const ProcessorStatistics& statistics() const
+  {
+    return m_statistics;
+  }
 
-  MessageProcessor(PublishCallback publish, RssiCallback rssi, String gatewayId) noexcept;
+  // Keys per node covered by the published device discovery configs. They are persisted by the caller and restored
+  // after a restart, as the retained config is replaced with the keys of the first packet otherwise.
+  [[nodiscard]] std::map<String, KeyMask> discoveredKeys() const
+  {
+    std::map<String, KeyMask> discoveredKeys;
+    for (const auto& [nodeId, node] : m_discoveredNodes) {
+      discoveredKeys.emplace_hint(discoveredKeys.end(), nodeId, node.keys);
+    }
+    return discoveredKeys;
+  }
 
-  void processMessage(const String& message) const;
+  // restored nodes count as heard before any packet received since
+  void restoreDiscoveredKeys(const std::map<String, KeyMask>& discoveredKeys)
+  {
+    const KeyMask knownKeys{discoveryInfoCount() < g_maxDiscoveryInfos ? (KeyMask{1U} << discoveryInfoCount()) - 1U
+                                                                        : ~KeyMask{0U}};
+    m_discoveredNodes.clear();
+    for (const auto& [nodeId, keys] : discoveredKeys) {
+      if (m_discoveredNodes.size() >= maxDiscoveredNodes) {
+        break;
+      }
+      m_discoveredNodes.emplace(nodeId, DiscoveredNode{keys & knownKeys, 0U});
+    }
+    ++m_discoveryRevision;
+  }
+
+  // changes whenever discoveredKeys() changes
+  [[nodiscard]] uint32_t discoveryRevision() const
+  {
+    return m_discoveryRevision;
+  }
 
 private:
-  PublishCallback m_publish;
-  RssiCallback m_rssi;
+  static constexpr std::size_t maxStatePayloadLength{512U};
+
+  struct DiscoveredNode
+  {
+    KeyMask keys;
+    uint32_t lastHeard; // m_discoverySequence at the last packet of the node
+  };
+
+  TSink m_sink;
   String m_gatewayId;
+  ProcessorOptions m_options;
+  std::map<String, DiscoveredNode> m_discoveredNodes;
+  uint32_t m_discoverySequence{0U};
+  uint32_t m_discoveryRevision{0U};
+  ProcessorStatistics m_statistics;
+
+  bool publish(const String& topic, const char* const payload, const std::size_t payloadLength)
+  {
+    ++m_statistics.publishes;
+    m_statistics.publishedBytes += static_cast<uint32_t>(topic.length() + payloadLength);
+    if (not m_sink(topic.c_str(), payload, payloadLength, true)) {
+      LOG_ERROR_RATE_LIMITED("publish failed");
+      return false;
+    }
+    return true;
+  }
+
+  bool publish(const String& topic, const JsonDocument& json)
+  {
+    String payload;
+    serializeJson(json, payload);
+    return publish(topic, payload.c_str(), payload.length());
+  }
+
+  void publishDiscovery(const String& nodeId, const KeyMask reportedKeys)
+  {
+    if (m_options.discoveryMode == DiscoveryMode::PerDevice) {
+      publishDeviceDiscoveryMessage(nodeId, reportedKeys);
+      return;
+    }
+
+    for (std::size_t index{0U}; index < discoveryInfoCount(); ++index) {
+      if ((reportedKeys & (KeyMask{1U} << index)) != 0U) {
+        JsonDocument json;
+        fillEntityDiscovery(json, index, nodeId, m_options.stateMode);
+        publish(entityDiscoveryTopic(index, nodeId), json);
+      }
+    }
+  }
+
+  void publishDeviceDiscoveryMessage(const String& nodeId, const KeyMask reportedKeys)
+  {
+    auto node{m_discoveredNodes.find(nodeId)};
+    if (node != m_discoveredNodes.end()) {
+      node->second.lastHeard = ++m_discoverySequence;
+    }
+    const KeyMask discoveredKeys{node != m_discoveredNodes.end() ? node->second.keys : KeyMask{0U}};
+    if ((reportedKeys & ~discoveredKeys) == 0U) {
+      return; // nothing new, the retained config is still complete
+    }
+
+    JsonDocument json;
+    fillDeviceDiscovery(json, nodeId, discoveredKeys | reportedKeys, m_options.stateMode);
+    // recorded only once sent, a failed config is sent again with the next packet of the node
+    if (not publish(deviceDiscoveryTopic(nodeId), json)) {
+      return;
+    }
+    if (node == m_discoveredNodes.end()) {
+      if (m_discoveredNodes.size() >= maxDiscoveredNodes) {
+        forgetLeastRecentNode();
+      }
+      node = m_discoveredNodes.emplace(nodeId, DiscoveredNode{0U, ++m_discoverySequence}).first;
+    }
+    node->second.keys = discoveredKeys | reportedKeys;
+    ++m_discoveryRevision;
+  }
+
+  // Should the forgotten node come back, its retained config is replaced with the keys it reports from then on.
+  void forgetLeastRecentNode()
+  {
+    const auto leastRecent{std::min_element(
+      m_discoveredNodes.begin(), m_discoveredNodes.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.second.lastHeard < rhs.second.lastHeard;
+      })};
+    LOG_WARNING_RATE_LIMITED("Too many nodes for device discovery, forgetting", leastRecent->first.c_str());
+    m_discoveredNodes.erase(leastRecent);
+  }
+
+  void publishAggregatedUpdate(const JsonDocument& doc)
+  {
+    const auto identifier{doc["id"].as<String>()};
+
+    JsonDocument state;
+    const KeyMask reportedKeys{copyState(doc, state)};
+    if (reportedKeys == 0U) {
+      return;
+    }
+    publishDiscovery(identifier, reportedKeys);
 
-  void publishDiscoveryMessage(const String& key, const String& nodeId) const;
-  void publishUpdate(const JsonDocument& doc) const;
+    // serialized straight into a stack buffer, handed to the sink without any String copies
+    char payload[maxStatePayloadLength];
+    const std::size_t length{measureJson(state)};
+    if (length >= sizeof(payload)) {
+      LOG_WARNING_RATE_LIMITED("State too large", static_cast<int32_t>(length));
+      return;
+    }
+    serializeJson(state, payload, sizeof(payload));
+    publish(aggregatedStateTopic(identifier), payload, length);
+  }
 };
 } // namespace message
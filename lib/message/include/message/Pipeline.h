@@ -0,0 +1,33 @@
+#pragma once
+
+#include <tuple>
+#include <utility>
+
+namespace message {
+// Calls the stages in order with the same context, a stage returning false drops the message. The stages are
+// stored by value and their types are known at compile time, so the whole chain can be inlined. A stage is any
+// type callable as bool(TContext&), see message/Stages.h.
+template<typename... TStages>
+class Pipeline
+{
+public:
+  explicit Pipeline(TStages... stages) noexcept
+    : m_stages{std::move(stages)...}
+  {
+  }
+
+  // returns true if the message passed all stages
+  template<typename TContext>
+  bool process(TContext& context)
+  {
+    return std::apply(
+      [&context](auto&... stages) {
+        return (stages(context) and ...);
+      },
+      m_stages);
+  }
+
+private:
+  std::tuple<TStages...> m_stages;
+};
+} // namespace message
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <utility>
+
+#include <ArduinoJson.h>
+
+#include <message/HomeAssistant.h>
+#include <packet/Packet.h>
+
+// Pipeline stages for received packets: the decoder comes first, filters and taps in between and the publisher
+// last. Filters keep their state per node for at most maxNodes nodes, further nodes are passed through unfiltered.
+namespace message {
+struct PipelineContext
+{
+  explicit PipelineContext(packet::Packet received) noexcept
+    : packet{std::move(received)}
+  {
+  }
+
+  packet::Packet packet;
+  JsonDocument doc; // filled by the decoder
+};
+
+class JsonDecoder
+{
+public:
+  JsonDecoder(String gatewayId, const bool publishLinkDiagnostics) noexcept
+    : m_gatewayId{std::move(gatewayId)}
+    , m_publishLinkDiagnostics{publishLinkDiagnostics}
+  {
+  }
+
+  bool operator()(PipelineContext& context) const
+  {
+    if (not decodeNodeMessage(context.packet.message, m_gatewayId, context.doc)) {
+      return false;
+    }
+    addMetadata(context.doc, context.packet.metadata, m_publishLinkDiagnostics);
+    return true;
+  }
+
+private:
+  String m_gatewayId;
+  bool m_publishLinkDiagnostics;
+};
+
+// Sums up the airtime per node and, if link diagnostics are enabled, adds the total since boot in seconds.
+class NodeAirtime
+{
+public:
+  static constexpr std::size_t maxNodes{256U};
+
+  explicit NodeAirtime(const bool publishLinkDiagnostics) noexcept
+    : m_publishLinkDiagnostics{publishLinkDiagnostics}
+  {
+  }
+
+  bool operator()(PipelineContext& context)
+  {
+    const auto nodeId{context.doc["id"].as<String>()};
+    auto total{m_totalUs.find(nodeId)};
+    if (total == m_totalUs.end()) {
+      if (m_totalUs.size() >= maxNodes) {
+        return true;
+      }
+      total = m_totalUs.emplace(nodeId, 0U).first;
+    }
+    total->second += context.packet.metadata.airtimeUs;
+
+    if (m_publishLinkDiagnostics) {
+      context.doc["ata"] = static_cast<double>(total->second) / 1'000'000.0;
+    }
+    return true;
+  }
+
+private:
+  bool m_publishLinkDiagnostics;
+  std::map<String, uint64_t> m_totalUs;
+};
+
+// Drops retransmissions, i.e. the same payload from the same node within the window. A zero window disables it.
+class DedupFilter
+{
+public:
+  static constexpr std::size_t maxNodes{256U};
+
+  explicit DedupFilter(const std::chrono::milliseconds window) noexcept
+    : m_windowUs{std::chrono::duration_cast<std::chrono::microseconds>(window).count()}
+  {
+  }
+
+  bool operator()(const PipelineContext& context)
+  {
+    if (m_windowUs <= 0) {
+      return true;
+    }
+    const LastPacket packet{hash(context.packet.message), context.packet.metadata.timestampUs};
+    const auto nodeId{context.doc["id"].as<String>()};
+    if (const auto last{m_lastPackets.find(nodeId)}; last != m_lastPackets.end()) {
+      // the first copy is kept, so a node repeating the same value periodically is not dropped forever
+      if (last->second.hash == packet.hash and packet.timestampUs - last->second.timestampUs < m_windowUs) {
+        return false;
+      }
+      last->second = packet;
+    } else if (m_lastPackets.size() < maxNodes) {
+      m_lastPackets.emplace(nodeId, packet);
+    }
+    return true;
+  }
+
+private:
+  struct LastPacket
+  {
+    uint32_t hash;
+    int64_t timestampUs;
+  };
+
+  int64_t m_windowUs;
+  std::map<String, LastPacket> m_lastPackets;
+
+  // FNV-1a
+  static uint32_t hash(const String& message)
+  {
+    uint32_t value{2166136261U};
+    for (std::size_t index{0U}; index < message.length(); ++index) {
+      value = (value ^ static_cast<uint8_t>(message[index])) * 16777619U;
+    }
+    return value;
+  }
+};
+
+// Removes a numeric key from the document while it stays within the deadband around the last value passed on, the
+// other keys of the packet are still published. Meant for the per key state mode, with aggregated state the entity
+// would see the key missing. A deadband of zero disables it.
+class DeadbandFilter
+{
+public:
+  static constexpr std::size_t maxNodes{256U};
+
+  DeadbandFilter(const char* const key, const double deadband) noexcept
+    : m_key{key}
+    , m_deadband{deadband}
+  {
+  }
+
+  bool operator()(PipelineContext& context)
+  {
+    if (m_deadband <= 0.0) {
+      return true;
+    }
+    const auto value{context.doc[m_key]};
+    if (not value.is<double>()) {
+      return true;
+    }
+    const double current{value.as<double>()};
+
+    const auto nodeId{context.doc["id"].as<String>()};
+    if (const auto last{m_lastValues.find(nodeId)}; last != m_lastValues.end()) {
+      if (std::fabs(current - last->second) < m_deadband) {
+        context.doc.remove(m_key);
+        return true;
+      }
+      last->second = current;
+    } else if (m_lastValues.size() < maxNodes) {
+      m_lastValues.emplace(nodeId, current);
+    }
+    return true;
+  }
+
+private:
+  const char* m_key;
+  double m_deadband;
+  std::map<String, double> m_lastValues;
+};
+
+struct PipelineMetrics
+{
+  uint32_t packets{0U};
+  uint32_t bytes{0U};          // received payload bytes
+  int64_t lastTimestampUs{0}; // esp_timer time of the last packet
+};
+
+// Counts the packets reaching its position in the pipeline, several taps can show where packets are dropped.
+class MetricsTap
+{
+public:
+  explicit MetricsTap(PipelineMetrics& metrics) noexcept
+    : m_metrics{&metrics}
+  {
+  }
+
+  bool operator()(const PipelineContext& context) const
+  {
+    ++m_metrics->packets;
+    m_metrics->bytes += static_cast<uint32_t>(context.packet.message.length());
+    m_metrics->lastTimestampUs = context.packet.metadata.timestampUs;
+    return true;
+  }
+
+private:
+  PipelineMetrics* m_metrics;
+};
+
+// Hands the document to a MessageProcessor, which has to outlive the pipeline.
+template<typename TProcessor>
+class Publisher
+{
+public:
+  explicit Publisher(TProcessor& processor) noexcept
+    : m_processor{&processor}
+  {
+  }
+
+  bool operator()(const PipelineContext& context) const
+  {
+    m_processor->publishUpdate(context.doc);
+    return true;
+  }
+
+private:
+  TProcessor* m_processor;
+};
+} // namespace message
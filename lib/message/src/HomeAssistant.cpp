@@ -0,0 +1,380 @@
+#include <message/HomeAssistant.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <iterator>
+
+#include <logging/Log.h>
+
+namespace message {
+namespace {
+constexpr auto g_mqttSensorTopic{"homeassistant/sensor/"};
+constexpr auto g_mqttBinarySensorTopic{"homeassistant/binary_sensor/"};
+constexpr auto g_mqttDeviceTopic{"homeassistant/device/"};
+constexpr auto g_origin{"LoRaGateway"};
+constexpr std::size_t g_maxMessageLength{255U}; // LoRa payload limit
+constexpr std::size_t g_maxNodeIdLength{32U};
+
+constexpr auto g_payloadOn{"on"};
+constexpr auto g_payloadOff{"off"};
+
+// Gateway keys are set by the gateway itself, e.g. link diagnostics, and are never taken from a node packet.
+enum class Source : uint8_t
+{
+  Node,
+  Gateway,
+};
+
+// The index of an entry is its bit in a KeyMask, masks are persisted, so entries are only ever appended.
+constexpr struct DiscoveryInfo
+{
+  const char* key;
+  const char* name;
+  const char* uniqueIdSuffix;
+  const char* topicPrefix;
+  const char* topicSuffix;
+  const char* deviceClass;
+  const char* unitOfMeasurement;
+  const char* icon;
+  const char* entityCategory;
+  const char* payloadOn;
+  const char* payloadOff;
+  ValueType valueType;
+  Source source;
+} g_discoveryInfos[]{
+  // clang-format off
+  {"b", "Battery", "_batt", g_mqttSensorTopic, "/batt", "battery", "%", "mdi:battery", "diagnostic", nullptr, nullptr, ValueType::Integer, Source::Node},
+  {"r", "RSSI", "_rssi", g_mqttSensorTopic, "/rssi", "signal_strength", "dBm", "mdi:signal", "diagnostic", nullptr, nullptr, ValueType::Integer, Source::Gateway},
+  {"snr", "SNR", "_snr", g_mqttSensorTopic, "/snr", "signal_strength", "dB", "mdi:signal-variant", "diagnostic", nullptr, nullptr, ValueType::Float, Source::Gateway},
+  {"fe", "Frequency Error", "_fe", g_mqttSensorTopic, "/freq_error", "frequency", "Hz", "mdi:sine-wave", "diagnostic", nullptr, nullptr, ValueType::Float, Source::Gateway},
+  {"at", "Airtime", "_at", g_mqttSensorTopic, "/airtime", "duration", "ms", "mdi:timer-outline", "diagnostic", nullptr, nullptr, ValueType::Float, Source::Gateway},
+  {"ata", "Airtime Total", "_ata", g_mqttSensorTopic, "/airtime_total", "duration", "s", "mdi:timer-sand-complete", "diagnostic", nullptr, nullptr, ValueType::Float, Source::Gateway},
+  {"ts", "Received At", "_ts", g_mqttSensorTopic, "/received_at", "duration", "ms", "mdi:clock-outline", "diagnostic", nullptr, nullptr, ValueType::Integer, Source::Gateway},
+  {"cu", "Channel Utilisation", "_cu", g_mqttSensorTopic, "/channel_utilisation", nullptr, "%", "mdi:chart-bell-curve", "diagnostic", nullptr, nullptr, ValueType::Float, Source::Gateway},
+  {"cp", "Collision Probability", "_cp", g_mqttSensorTopic, "/collision_probability", nullptr, "%", "mdi:call-merge", "diagnostic", nullptr, nullptr, ValueType::Float, Source::Gateway},
+  {"wk", "Wake Count", "_wk", g_mqttSensorTopic, "/wake_count", nullptr, nullptr, "mdi:sleep-off", "diagnostic", nullptr, nullptr, ValueType::Integer, Source::Gateway},
+  {"awk", "Awake Time", "_awk", g_mqttSensorTopic, "/awake_time", "duration", "s", "mdi:timer-sand", "diagnostic", nullptr, nullptr, ValueType::Integer, Source::Gateway},
+  {"wot", "WiFi On Time", "_wot", g_mqttSensorTopic, "/wifi_on_time", "duration", "s", "mdi:wifi-strength-outline", "diagnostic", nullptr, nullptr, ValueType::Integer, Source::Gateway},
+  {"rw", "Text", "_row", g_mqttSensorTopic, "/row", nullptr, nullptr, "mdi:text", nullptr, nullptr, nullptr, ValueType::String, Source::Node},
+  {"s", "State", "_state", g_mqttSensorTopic, "/state", nullptr, nullptr, "mdi:list-status", nullptr, nullptr, nullptr, ValueType::String, Source::Node},
+  {"v", "Volt", "_volt", g_mqttSensorTopic, "/volt", "voltage", "V", "mdi:flash-triangle", nullptr, nullptr, nullptr, ValueType::Float, Source::Node},
+  {"pw", "Current", "_pw", g_mqttSensorTopic, "/current", "current", "mA", "mdi:current-dc", nullptr, nullptr, nullptr, ValueType::Float, Source::Node},
+  {"l", "Lux", "_lx", g_mqttSensorTopic, "/lx", "illuminance", "lx", "mdi:brightness-1", nullptr, nullptr, nullptr, ValueType::Integer, Source::Node},
+  {"w", "Weight", "_w", g_mqttSensorTopic, "/weight", "weight", "g", "mdi:weight", nullptr, nullptr, nullptr, ValueType::Float, Source::Node},
+  {"t", "Temperature", "_tmp", g_mqttSensorTopic, "/tmp", "temperature", "°C", "mdi:thermometer", nullptr, nullptr, nullptr, ValueType::Float, Source::Node},
+  {"t2", "Temperature2", "_tmp2", g_mqttSensorTopic, "/tmp2", "temperature", "°C", "mdi:thermometer", nullptr, nullptr, nullptr, ValueType::Float, Source::Node},
+  {"hu", "Humidity", "_hu", g_mqttSensorTopic, "/humidity", "humidity", "%", "mdi:water-percent", nullptr, nullptr, nullptr, ValueType::Float, Source::Node},
+  {"mo", "Moisture", "_mo", g_mqttSensorTopic, "/moisture", "moisture", "%", "mdi:water-percent", nullptr, nullptr, nullptr, ValueType::Float, Source::Node},
+  {"bt", "Button", "_bt", g_mqttBinarySensorTopic, "/button", "none", nullptr, "mdi:button", nullptr, g_payloadOn, g_payloadOff, ValueType::String, Source::Node},
+  {"atm", "Pressure", "_atm", g_mqttSensorTopic, "/pressure", "atmospheric_pressure", "kPa", "mdi:button", nullptr, nullptr, nullptr, ValueType::Float, Source::Node},
+  {"cd", "Carbon Dioxide", "_cd", g_mqttSensorTopic, "/co2", "carbon_dioxide", "ppm", "mdi:molecule-co2", nullptr, nullptr, nullptr, ValueType::Integer, Source::Node},
+  {"m", "Motion", "_m", g_mqttBinarySensorTopic, "/motion", "motion", nullptr, "mdi:motion", nullptr, g_payloadOn, g_payloadOff, ValueType::String, Source::Node},
+  {"dr", "Door", "_door", g_mqttBinarySensorTopic, "/door", "door", nullptr, "mdi:door", nullptr, g_payloadOn, g_payloadOff, ValueType::String, Source::Node},
+  {"wd", "Window", "_window", g_mqttBinarySensorTopic, "/window", "window", nullptr, "mdi:window-closed", nullptr, g_payloadOn, g_payloadOff, ValueType::String, Source::Node},
+  {"vb", "Vibration", "_vibration", g_mqttBinarySensorTopic, "/vibration", "vibration", nullptr, "mdi:vibrate", nullptr, g_payloadOn, g_payloadOff, ValueType::String, Source::Node},
+  {"pp", "Publishes Per Packet", "_pp", g_mqttSensorTopic, "/publishes_per_packet", nullptr, nullptr, "mdi:upload-multiple", "diagnostic", nullptr, nullptr, ValueType::Float, Source::Gateway},
+  {"bp", "Bytes Per Packet", "_bp", g_mqttSensorTopic, "/bytes_per_packet", nullptr, "B", "mdi:file-upload-outline", "diagnostic", nullptr, nullptr, ValueType::Float, Source::Gateway},
+  // clang-format on
+};
+
+constexpr std::size_t g_discoveryInfoCount{std::size(g_discoveryInfos)};
+static_assert(g_discoveryInfoCount <= g_maxDiscoveryInfos, "KeyMask too small for all discovery infos");
+
+const char*
+platformOf(const DiscoveryInfo* info)
+{
+  return info->topicPrefix == g_mqttBinarySensorTopic ? "binary_sensor" : "sensor";
+}
+
+void
+fillDevice(const JsonObject device, const String& nodeId)
+{
+  const auto identifiers{device["ids"].to<JsonArray>()};
+  // ReSharper disable once CppExpressionWithoutSideEffects
+  identifiers.add(nodeId);
+  device["name"] = nodeId;
+  device["mdl"] = nodeId;
+  device["mf"] = "PricelessToolkit";
+}
+
+void
+fillComponent(const JsonObject json, const DiscoveryInfo* info, const String& nodeId, const StateMode stateMode)
+{
+  json["name"] = info->name;
+  json["unique_id"] = nodeId + info->uniqueIdSuffix;
+  if (stateMode == StateMode::Aggregated) {
+    json["state_topic"] = aggregatedStateTopic(nodeId);
+    // a packet only carries some of the keys, the template must not fail on the missing ones
+    json["val_tpl"] =
+      String{"{% if '"} + info->key + "' in value_json %}{{ value_json." + info->key + " }}{% endif %}";
+  } else {
+    json["state_topic"] = String{info->topicPrefix} + nodeId + info->topicSuffix;
+  }
+  if (info->deviceClass != nullptr) {
+    json["device_class"] = info->deviceClass;
+  }
+  if (info->unitOfMeasurement != nullptr) {
+    json["unit_of_meas"] = info->unitOfMeasurement;
+  }
+  if (info->icon != nullptr) {
+    json["icon"] = info->icon;
+  }
+  if (info->entityCategory != nullptr) {
+    json["ent_cat"] = info->entityCategory;
+  }
+  if (info->payloadOn != nullptr) {
+    json["payload_on"] = info->payloadOn;
+  }
+  if (info->payloadOff != nullptr) {
+    json["payload_off"] = info->payloadOff;
+  }
+}
+
+void
+fillJsonDoc(JsonDocument& json, const DiscoveryInfo* info, const String& nodeId, const StateMode stateMode)
+{
+  fillComponent(json.to<JsonObject>(), info, nodeId, stateMode);
+  fillDevice(json["device"].to<JsonObject>(), nodeId);
+}
+
+std::optional<String>
+convertToString(const JsonDocument& doc, const String& key, const ValueType valueType)
+{
+  const auto value = doc[key];
+
+  switch (valueType) {
+    case ValueType::Integer: {
+      if (value.is<unsigned long>()) {
+        return String(value.as<unsigned long>());
+      }
+      if (value.is<long>()) {
+        return String(value.as<long>());
+      }
+    } break;
+
+    case ValueType::Float: {
+      if (value.is<double>()) {
+        return String(value.as<double>(), 2);
+      }
+    } break;
+
+    case ValueType::String:
+      if (value.is<const char*>() or value.is<String>()) {
+        return value.as<String>();
+      }
+      break;
+  }
+  return std::nullopt;
+}
+
+// Only known node keys are kept, so the document size is bounded no matter what the packet contains and a node
+// cannot fake gateway values.
+const JsonDocument&
+messageFilter()
+{
+  static const JsonDocument filter{[] {
+    JsonDocument doc;
+    doc["k"] = true;
+    doc["id"] = true;
+    for (const auto& info : g_discoveryInfos) {
+      if (info.source == Source::Node) {
+        doc[info.key] = true;
+      }
+    }
+    return doc;
+  }()};
+  return filter;
+}
+
+// The node ID becomes part of MQTT topics, so wildcards, separators and control characters are rejected.
+bool
+isValidNodeId(const char* const nodeId)
+{
+  const std::size_t length{strlen(nodeId)};
+  return length > 0U and length <= g_maxNodeIdLength and std::all_of(nodeId, nodeId + length, [](const char character) {
+           return std::isalnum(static_cast<unsigned char>(character)) or character == '_' or character == '-';
+         });
+}
+
+// Copies the value with its JSON type, floats are rounded to two decimals like in convertToString().
+bool
+copyValue(const JsonDocument& doc, const DiscoveryInfo& info, JsonDocument& state)
+{
+  const auto value{doc[info.key]};
+
+  switch (info.valueType) {
+    case ValueType::Integer: {
+      if (value.is<unsigned long>()) {
+        state[info.key] = value.as<unsigned long>();
+        return true;
+      }
+      if (value.is<long>()) {
+        state[info.key] = value.as<long>();
+        return true;
+      }
+    } break;
+
+    case ValueType::Float: {
+      if (value.is<double>()) {
+        state[info.key] = std::round(value.as<double>() * 100.0) / 100.0;
+        return true;
+      }
+    } break;
+
+    case ValueType::String:
+      if (value.is<const char*>() and *value.as<const char*>() != '\0') {
+        state[info.key] = value.as<const char*>();
+        return true;
+      }
+      break;
+  }
+  return false;
+}
+} // namespace
+
+std::size_t
+discoveryInfoCount()
+{
+  return g_discoveryInfoCount;
+}
+
+const char*
+discoveryKey(const std::size_t index)
+{
+  return g_discoveryInfos[index].key;
+}
+
+ValueType
+discoveryValueType(const std::size_t index)
+{
+  return g_discoveryInfos[index].valueType;
+}
+
+bool
+isGatewayKey(const std::size_t index)
+{
+  return g_discoveryInfos[index].source == Source::Gateway;
+}
+
+bool
+decodeNodeMessage(const String& message, const String& gatewayId, JsonDocument& doc)
+{
+  if (message.isEmpty()) {
+    return false;
+  }
+  LOG_DEBUG("Received message", message.c_str());
+
+  if (message.length() > g_maxMessageLength) {
+    LOG_WARNING_RATE_LIMITED("Message too long", static_cast<int32_t>(message.length()));
+    return false;
+  }
+
+  // flat objects only
+  if (const auto error{deserializeJson(
+        doc, message, DeserializationOption::Filter(messageFilter()), DeserializationOption::NestingLimit(1))}) {
+    LOG_WARNING_RATE_LIMITED("Failed to deserialize JSON", error.c_str());
+    return false;
+  }
+
+  if (not doc["k"].is<String>()) {
+    LOG_WARNING_RATE_LIMITED("Gateway key not found");
+    return false;
+  }
+
+  if (doc["k"].as<String>() != gatewayId) {
+    return false;
+  }
+
+  if (not doc["id"].is<const char*>() or not isValidNodeId(doc["id"].as<const char*>())) {
+    LOG_WARNING_RATE_LIMITED("No or invalid node ID");
+    return false;
+  }
+  return true;
+}
+
+void
+addMetadata(JsonDocument& doc, const packet::PacketMetadata& metadata, const bool publishLinkDiagnostics)
+{
+  doc["r"] = static_cast<int>(metadata.rssi);
+  if (publishLinkDiagnostics) {
+    doc["snr"] = metadata.snr;
+    doc["fe"] = metadata.frequencyError;
+    doc["at"] = static_cast<float>(metadata.airtimeUs) / 1000.0F;
+    // gateway uptime at DIO1 time, lets consecutive packets of a node be related to each other
+    doc["ts"] = static_cast<uint32_t>(metadata.timestampUs / 1000);
+  } else {
+    doc.remove("snr");
+    doc.remove("fe");
+    doc.remove("at");
+    doc.remove("ts");
+  }
+}
+
+std::optional<String>
+stateValue(const JsonDocument& doc, const std::size_t index)
+{
+  const auto& info{g_discoveryInfos[index]};
+  return convertToString(doc, info.key, info.valueType);
+}
+
+String
+stateTopic(const std::size_t index, const String& nodeId)
+{
+  const auto& info{g_discoveryInfos[index]};
+  return String{info.topicPrefix} + nodeId + info.topicSuffix;
+}
+
+KeyMask
+copyState(const JsonDocument& doc, JsonDocument& state)
+{
+  KeyMask copiedKeys{0U};
+  for (std::size_t index{0U}; index < g_discoveryInfoCount; ++index) {
+    if (copyValue(doc, g_discoveryInfos[index], state)) {
+      copiedKeys |= KeyMask{1U} << index;
+    }
+  }
+  return copiedKeys;
+}
+
+String
+aggregatedStateTopic(const String& nodeId)
+{
+  return String{g_mqttDeviceTopic} + nodeId + "/state";
+}
+
+String
+entityDiscoveryTopic(const std::size_t index, const String& nodeId)
+{
+  return stateTopic(index, nodeId) + "/config";
+}
+
+void
+fillEntityDiscovery(JsonDocument& json, const std::size_t index, const String& nodeId, const StateMode stateMode)
+{
+  fillJsonDoc(json, &g_discoveryInfos[index], nodeId, stateMode);
+}
+
+String
+deviceDiscoveryTopic(const String& nodeId)
+{
+  return String{g_mqttDeviceTopic} + nodeId + "/config";
+}
+
+void
+fillDeviceDiscovery(JsonDocument& json, const String& nodeId, const KeyMask keys, const StateMode stateMode)
+{
+  fillDevice(json["dev"].to<JsonObject>(), nodeId);
+  json["o"]["name"] = g_origin;
+  const auto components{json["cmps"].to<JsonObject>()};
+  for (std::size_t index{0U}; index < g_discoveryInfoCount; ++index) {
+    if ((keys & (KeyMask{1U} << index)) == 0U) {
+      continue;
+    }
+    const DiscoveryInfo* info{&g_discoveryInfos[index]};
+    const auto component{components[nodeId + info->uniqueIdSuffix].to<JsonObject>()};
+    component["p"] = platformOf(info);
+    fillComponent(component, info, nodeId, stateMode);
+  }
+}
+} // namespace message
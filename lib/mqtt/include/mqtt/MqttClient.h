@@ -1,7 +1,12 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
 #include <optional>
 
 #include <Arduino.h>
@@ -49,6 +54,8 @@ private:
 class MqttClient
 {
 public:
+  using MessageCallback = std::function<void(const char* topic, const char* payload)>;
+
   MqttClient(String ssid,
              String wifiPassword,
              String mqttUsername,
@@ -58,11 +65,37 @@ public:
              std::uint16_t mqttPort = 1883,
              std::optional<TlsConfig> tlsConfig = std::nullopt) noexcept;
   bool publish(const String& topic, const String& payload, bool retain = true);
-  void connect();
+  bool publish(const char* topic, const char* payload, std::size_t length, bool retain = true);
+  // the callback is invoked from the MQTT task, not from the loop task
+  void subscribe(const String& topic, MessageCallback callback);
+  // returns false if the timeout expired before WiFi and MQTT were connected
+  bool connect(std::optional<std::chrono::milliseconds> timeout = std::nullopt);
+  // non-blocking variant of connect(): starts connecting, pollConnect() continues and returns true once WiFi and MQTT
+  // are connected
+  void startConnect();
+  bool pollConnect();
+  // switches WiFi off until the next connect(), no reconnect attempts are made in between
+  void disconnect();
+
+  // Enables WiFi modem sleep and queues publishes while disconnected until flush() is called. Must be set before
+  // the first connect(). A full queue drops the oldest state, discovery configs are kept and publish() fails instead.
+  void setPowerSaving(bool enabled);
+  // sends the queued publishes, returns false if some are still queued
+  bool flush();
+  [[nodiscard]] std::chrono::milliseconds wifiOnTime() const;
 
 private:
+  struct QueuedMessage
+  {
+    String topic;
+    String payload;
+    bool retain;
+  };
+
   void init();
   void attemptWifiReconnect();
+  // returns false if the queue is full of discovery configs
+  bool enqueue(const char* topic, const char* payload, std::size_t length, bool retain);
 
   String m_ssid;
   String m_wifiPassword;
@@ -74,6 +107,14 @@ private:
   std::optional<TlsConfig> m_tlsConfig;
   std::atomic<std::uint32_t> m_nextReconnectMs;
   bool m_initialized;
+  bool m_mqttStarted;
+  bool m_powerSaving;
+  std::atomic<bool> m_suspended;
+  std::list<String> m_subscriptions; // the client keeps pointers to the topics
+  std::deque<QueuedMessage> m_queue;
+  std::uint32_t m_wifiOnSinceMs;
+  std::chrono::milliseconds m_wifiOnTime;
+  bool m_wifiOn;
 
   PsychicMqttClient m_mqttClient;
 };
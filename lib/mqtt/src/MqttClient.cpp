@@ -1,16 +1,27 @@
 #include <mqtt/MqttClient.h>
 
+#include <algorithm>
 #include <chrono>
 #include <utility>
 
 #include <WiFi.h>
 
+#include <logging/Log.h>
+
 namespace mqtt {
 
 using namespace std::chrono_literals;
 
 namespace {
 constexpr std::chrono::milliseconds g_reconnectBackoff{15s};
+constexpr std::chrono::milliseconds g_powerSavingMqttReconnectTimeout{1s};
+constexpr std::size_t g_maxQueuedMessages{64U};
+
+bool
+isDiscoveryConfig(const String& topic)
+{
+  return topic.endsWith("/config");
+}
 
 const char*
 disconnectReasonFor(const std::uint8_t reasonCode)
@@ -37,6 +48,12 @@ MqttClient::MqttClient(String ssid,
   , m_tlsConfig{std::move(tlsConfig)}
   , m_nextReconnectMs{0U}
   , m_initialized{false}
+  , m_mqttStarted{false}
+  , m_powerSaving{false}
+  , m_suspended{false}
+  , m_wifiOnSinceMs{0U}
+  , m_wifiOnTime{0}
+  , m_wifiOn{false}
 {
   // WiFi stuff must not be done here
 }
@@ -44,27 +61,144 @@ MqttClient::MqttClient(String ssid,
 bool
 MqttClient::publish(const String& topic, const String& payload, const bool retain)
 {
-  return m_mqttClient.publish(topic.c_str(), 2, retain, payload.c_str(), static_cast<int>(payload.length())) != -1;
+  return publish(topic.c_str(), payload.c_str(), payload.length(), retain);
+}
+
+bool
+MqttClient::publish(const char* const topic, const char* const payload, const std::size_t length, const bool retain)
+{
+  if (m_powerSaving and not m_mqttClient.connected()) {
+    return enqueue(topic, payload, length, retain);
+  }
+  return m_mqttClient.publish(topic, 2, retain, payload, static_cast<int>(length)) != -1;
 }
 
 void
-MqttClient::connect()
+MqttClient::subscribe(const String& topic, MessageCallback callback)
+{
+  const auto& subscription{m_subscriptions.emplace_back(topic)};
+  m_mqttClient.onTopic(
+    subscription.c_str(),
+    2,
+    [callback = std::move(callback)](char* const messageTopic, char* const payload, int, int, bool) {
+      callback(messageTopic, payload);
+    });
+}
+
+bool
+MqttClient::connect(const std::optional<std::chrono::milliseconds> timeout)
+{
+  const auto start{millis()};
+  startConnect();
+  while (not pollConnect()) {
+    if (timeout and millis() - start >= timeout->count()) {
+      return false;
+    }
+    delay(100);
+  }
+  return true;
+}
+
+void
+MqttClient::startConnect()
 {
   init();
 
-  Serial.println(F("WiFi connecting..."));
+  m_suspended = false;
+  if (not m_wifiOn) {
+    m_wifiOn = true;
+    m_wifiOnSinceMs = millis();
+  }
+
+  LOG_INFO("WiFi connecting...");
   WiFi.begin(m_ssid, m_wifiPassword);
-  while (not WiFi.isConnected()) {
-    delay(500);
+}
+
+bool
+MqttClient::pollConnect()
+{
+  if (not WiFi.isConnected()) {
+    return false;
+  }
+
+  if (not m_mqttStarted) {
+    LOG_INFO("MQTT connecting...");
+    // afterwards the client reconnects on its own
+    m_mqttClient.connect();
+    m_mqttStarted = true;
   }
+  return m_mqttClient.connected();
+}
 
-  Serial.println(F("MQTT connecting..."));
-  m_mqttClient.connect();
-  while (not m_mqttClient.connected()) {
-    delay(500);
+void
+MqttClient::disconnect()
+{
+  m_suspended = true;
+  WiFi.disconnect(true);
+  if (m_wifiOn) {
+    m_wifiOnTime += std::chrono::milliseconds{millis() - m_wifiOnSinceMs};
+    m_wifiOn = false;
   }
 }
 
+void
+MqttClient::setPowerSaving(const bool enabled)
+{
+  m_powerSaving = enabled;
+}
+
+bool
+MqttClient::flush()
+{
+  while (not m_queue.empty()) {
+    const auto& message{m_queue.front()};
+    if (m_mqttClient.publish(message.topic.c_str(),
+                             2,
+                             message.retain,
+                             message.payload.c_str(),
+                             static_cast<int>(message.payload.length())) == -1) {
+      return false;
+    }
+    m_queue.pop_front();
+  }
+  return true;
+}
+
+std::chrono::milliseconds
+MqttClient::wifiOnTime() const
+{
+  return m_wifiOn ? m_wifiOnTime + std::chrono::milliseconds{millis() - m_wifiOnSinceMs} : m_wifiOnTime;
+}
+
+bool
+MqttClient::enqueue(const char* const topic, const char* const payload, const std::size_t length, const bool retain)
+{
+  // only the latest state per topic is of interest
+  for (auto& message : m_queue) {
+    if (message.topic == topic) {
+      message.payload = String{payload, length};
+      message.retain = retain;
+      return true;
+    }
+  }
+
+  if (m_queue.size() >= g_maxQueuedMessages) {
+    // discovery configs may be sent only once, the oldest state is dropped instead. If the queue holds configs only,
+    // the new message is rejected so the caller sends it again later.
+    const auto state{std::find_if(m_queue.begin(), m_queue.end(), [](const QueuedMessage& message) {
+      return not isDiscoveryConfig(message.topic);
+    })};
+    if (state == m_queue.end()) {
+      LOG_WARNING_RATE_LIMITED("Publish queue full, message rejected");
+      return false;
+    }
+    LOG_WARNING_RATE_LIMITED("Publish queue full, oldest state dropped");
+    m_queue.erase(state);
+  }
+  m_queue.push_back({String{topic}, String{payload, length}, retain});
+  return true;
+}
+
 void
 MqttClient::init()
 {
@@ -74,19 +208,20 @@ MqttClient::init()
 
   WiFi.persistent(false);
   WiFi.setAutoReconnect(false); // builtin autoreconnect does not reconnect in some cases
-  WiFi.setSleep(false);
+  WiFi.setSleep(m_powerSaving);
   WiFi.onEvent([this](const WiFiEvent_t event, const WiFiEventInfo_t& info) {
     switch (event) {
       case ARDUINO_EVENT_WIFI_STA_CONNECTED: {
-        Serial.println(F("WiFi connected"));
+        LOG_INFO("WiFi connected");
       } break;
       case ARDUINO_EVENT_WIFI_STA_GOT_IP: {
-        Serial.print(F("IP address: "));
-        Serial.println(WiFi.localIP());
+        LOG_INFO("IP address", WiFi.localIP().toString().c_str());
       } break;
       case ARDUINO_EVENT_WIFI_STA_DISCONNECTED: {
-        Serial.printf(F("WiFi disconnected (Reason: %s)\n"), disconnectReasonFor(info.wifi_sta_disconnected.reason));
-        attemptWifiReconnect();
+        LOG_WARNING("WiFi disconnected", disconnectReasonFor(info.wifi_sta_disconnected.reason));
+        if (not m_suspended) {
+          attemptWifiReconnect();
+        }
       } break;
       default:;
     }
@@ -96,6 +231,11 @@ MqttClient::init()
   m_mqttClient.setClientId(m_clientId.c_str());
   m_mqttClient.setServer(m_mqttServer.c_str());
   m_mqttClient.getMqttConfig()->broker.address.port = m_mqttPort;
+  if (m_powerSaving) {
+    // reconnect quickly at the start of a wake window
+    m_mqttClient.getMqttConfig()->network.reconnect_timeout_ms =
+      static_cast<int>(g_powerSavingMqttReconnectTimeout.count());
+  }
 
   if (m_tlsConfig) {
     m_mqttClient.setCACert(m_tlsConfig->caCert().c_str());
@@ -106,12 +246,12 @@ MqttClient::init()
 
   m_mqttClient.setAutoReconnect(true);
   m_mqttClient.onConnect([](bool) {
-    Serial.println(F("MQTT connected"));
+    LOG_INFO("MQTT connected");
   });
   m_mqttClient.onDisconnect([this](bool) {
     // this callback is called cyclically until connected again
-    Serial.println(F("MQTT disconnected"));
-    if (not WiFi.isConnected()) {
+    LOG_WARNING_RATE_LIMITED("MQTT disconnected");
+    if (not WiFi.isConnected() and not m_suspended) {
       attemptWifiReconnect();
     }
   });
@@ -133,9 +273,9 @@ MqttClient::attemptWifiReconnect()
 
     if (const auto newScheduled = now + g_reconnectBackoff.count();
         m_nextReconnectMs.compare_exchange_weak(scheduled, newScheduled, std::memory_order_relaxed)) {
-      Serial.println("Attempting reconnect...");
+      LOG_INFO("Attempting reconnect...");
       if (not WiFi.reconnect()) {
-        Serial.println("Reconnect failed");
+        LOG_ERROR("Reconnect failed");
       }
       return;
     }
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+#include <Arduino.h>
+
+namespace packet {
+struct PacketMetadata
+{
+  float rssi;           // dBm
+  float snr;            // dB
+  float frequencyError; // Hz
+  int64_t timestampUs;  // esp_timer time at which DIO1 fired
+  uint32_t airtimeUs;
+};
+
+struct Packet
+{
+  String message;
+  PacketMetadata metadata;
+};
+} // namespace packet
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include <crypto/Aes.hpp>
+#include <crypto/KeyRing.hpp>
+#include <packet/Packet.h>
+
+namespace packet {
+// Header check, key selection, decryption and printable check of a raw packet, independent of the radio.
+//
+// Packet layout: [header] IV ciphertext
+// Legacy packets have no header and always a length that is a multiple of the AES block size. The header
+// (version, key ID, gateway key length, gateway key) is kept shorter than one block to tell both apart.
+class PacketDecoder
+{
+public:
+  static constexpr std::size_t maxPacketLength{255U}; // LoRa payload limit
+  static constexpr uint8_t headerVersion{1U};
+  static constexpr std::size_t headerFixedLength{3U};
+  static constexpr std::size_t maxGatewayKeyLength{N_BLOCK - 1U - headerFixedLength}; // gateway_id is limited to this
+
+  PacketDecoder(crypto::KeyRing keyRing, String gatewayId) noexcept;
+
+  // The data is not modified but has to be mutable for the cipher API.
+  std::optional<Packet> decode(byte* data, std::size_t length, const PacketMetadata& metadata);
+  void setKeyRing(crypto::KeyRing keyRing);
+
+private:
+  crypto::KeyRing m_keyRing;
+  String m_gatewayId;
+};
+} // namespace packet
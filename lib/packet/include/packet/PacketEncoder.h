@@ -0,0 +1,30 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <cstddef>
+
+#include <crypto/KeyRing.hpp>
+#include <packet/PacketDecoder.h>
+
+namespace packet {
+// Builds packets like a node does: header, IV and ciphertext. The counterpart of PacketDecoder for the host tests
+// and the benchmark, the nodes have their own implementation.
+class PacketEncoder
+{
+public:
+  PacketEncoder(crypto::KeyRing keyRing, String gatewayId) noexcept;
+
+  // the IV takes one block, the CMS padding at least one byte up to the next block
+  [[nodiscard]] std::size_t maxPlaintextLength() const;
+  // The output has to hold PacketDecoder::maxPacketLength bytes. Returns the packet length, 0 if the key ID is
+  // unknown or the plaintext longer than maxPlaintextLength().
+  std::size_t encode(crypto::KeyRing::KeyId keyId, const byte* plaintext, std::size_t length, byte* output) const;
+
+private:
+  crypto::KeyRing m_keyRing;
+  String m_gatewayId;
+
+  [[nodiscard]] std::size_t headerLength() const;
+};
+} // namespace packet
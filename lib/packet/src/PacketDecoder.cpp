@@ -0,0 +1,120 @@
+#include <packet/PacketDecoder.h>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <utility>
+
+#include <logging/Log.h>
+
+namespace packet {
+namespace {
+constexpr crypto::KeyRing::KeyId g_legacyKeyId{0U};
+
+struct Header
+{
+  crypto::KeyRing::KeyId keyId;
+  const byte* gatewayKey; // nullptr for legacy packets
+  std::size_t gatewayKeyLength;
+  std::size_t length;
+};
+
+std::optional<String>
+toString(const char* const array, const std::size_t length)
+{
+  const bool isPrintable{std::all_of(array, array + length, [](const char character) {
+    return std::isprint(static_cast<unsigned char>(character));
+  })};
+
+  return isPrintable ? std::make_optional(String{array, length}) : std::nullopt;
+}
+
+std::optional<Header>
+parseHeader(const byte* const data, const std::size_t length)
+{
+  if (length % N_BLOCK == 0U) {
+    return Header{g_legacyKeyId, nullptr, 0U, 0U};
+  }
+  if (length < PacketDecoder::headerFixedLength or data[0] != PacketDecoder::headerVersion) {
+    return std::nullopt;
+  }
+
+  const std::size_t gatewayKeyLength{data[2]};
+  const std::size_t headerLength{PacketDecoder::headerFixedLength + gatewayKeyLength};
+  if (gatewayKeyLength > PacketDecoder::maxGatewayKeyLength or length < headerLength or
+      (length - headerLength) % N_BLOCK != 0U) {
+    return std::nullopt;
+  }
+
+  return Header{data[1], data + PacketDecoder::headerFixedLength, gatewayKeyLength, headerLength};
+}
+
+std::optional<String>
+decrypt(crypto::Aes& cipher, byte* const data, const std::size_t length, const crypto::Aes::KeySlot slot)
+{
+  // the plaintext is never longer than the ciphertext, the IV is not part of it
+  std::array<byte, PacketDecoder::maxPacketLength> decryptedMessageBuffer;
+  const auto decryptedSize{cipher.decrypt(data, length, decryptedMessageBuffer.data(), slot)};
+
+  if (decryptedSize == 0 or decryptedSize > length) {
+    return std::nullopt;
+  }
+
+  return toString(reinterpret_cast<const char*>(decryptedMessageBuffer.data()), decryptedSize);
+}
+} // namespace
+
+PacketDecoder::PacketDecoder(crypto::KeyRing keyRing, String gatewayId) noexcept
+  : m_keyRing{std::move(keyRing)}
+  , m_gatewayId{std::move(gatewayId)}
+{
+}
+
+std::optional<Packet>
+PacketDecoder::decode(byte* const data, const std::size_t length, const PacketMetadata& metadata)
+{
+  if (length > maxPacketLength) {
+    return std::nullopt;
+  }
+
+  const auto header{parseHeader(data, length)};
+  if (not header) {
+    LOG_WARNING_RATE_LIMITED("Invalid packet header");
+    return std::nullopt;
+  }
+
+  // packets for other gateways are dropped before doing any crypto work
+  if (header->gatewayKey != nullptr and
+      (header->gatewayKeyLength != m_gatewayId.length() or
+       memcmp(header->gatewayKey, m_gatewayId.c_str(), header->gatewayKeyLength) != 0)) {
+    return std::nullopt;
+  }
+
+  crypto::Aes* const cipher{m_keyRing.find(header->keyId)};
+  if (cipher == nullptr) {
+    LOG_WARNING_RATE_LIMITED("Unknown key ID", header->keyId);
+    return std::nullopt;
+  }
+
+  byte* const encrypted{data + header->length};
+  const std::size_t encryptedLength{length - header->length};
+  auto string{decrypt(*cipher, encrypted, encryptedLength, crypto::Aes::KeySlot::Current)};
+  if (not string and cipher->hasPreviousKey()) {
+    string = decrypt(*cipher, encrypted, encryptedLength, crypto::Aes::KeySlot::Previous);
+  }
+
+  if (not string) {
+    LOG_WARNING_RATE_LIMITED("Failed to decrypt data");
+    return std::nullopt;
+  }
+
+  return Packet{std::move(*string), metadata};
+}
+
+void
+PacketDecoder::setKeyRing(crypto::KeyRing keyRing)
+{
+  m_keyRing = std::move(keyRing);
+}
+} // namespace packet
@@ -0,0 +1,43 @@
+#include <packet/PacketEncoder.h>
+
+#include <cstring>
+#include <utility>
+
+namespace packet {
+PacketEncoder::PacketEncoder(crypto::KeyRing keyRing, String gatewayId) noexcept
+  : m_keyRing{std::move(keyRing)}
+  , m_gatewayId{std::move(gatewayId)}
+{
+}
+
+std::size_t
+PacketEncoder::maxPlaintextLength() const
+{
+  return ((PacketDecoder::maxPacketLength - headerLength() - N_BLOCK) / N_BLOCK * N_BLOCK) - 1U;
+}
+
+std::size_t
+PacketEncoder::encode(const crypto::KeyRing::KeyId keyId,
+                      const byte* const plaintext,
+                      const std::size_t length,
+                      byte* const output) const
+{
+  crypto::Aes* const cipher{m_keyRing.find(keyId)};
+  if (cipher == nullptr or m_gatewayId.length() > PacketDecoder::maxGatewayKeyLength or
+      length > maxPlaintextLength()) {
+    return 0U;
+  }
+
+  output[0] = PacketDecoder::headerVersion;
+  output[1] = keyId;
+  output[2] = static_cast<byte>(m_gatewayId.length());
+  memcpy(output + PacketDecoder::headerFixedLength, m_gatewayId.c_str(), m_gatewayId.length());
+  return headerLength() + cipher->encrypt(plaintext, static_cast<uint16_t>(length), output + headerLength());
+}
+
+std::size_t
+PacketEncoder::headerLength() const
+{
+  return PacketDecoder::headerFixedLength + m_gatewayId.length();
+}
+} // namespace packet
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace power {
+
+struct PowerStatistics
+{
+  std::uint32_t wakeCount;
+  std::chrono::milliseconds awakeTime;
+};
+
+class PowerManager
+{
+public:
+  explicit PowerManager(std::uint8_t wakePin);
+
+  // Enters light sleep until the wake pin goes high or the duration expires. Returns true if woken by the pin.
+  bool lightSleep(std::chrono::milliseconds duration);
+  [[nodiscard]] PowerStatistics statistics() const;
+
+private:
+  std::uint8_t m_wakePin;
+  std::uint32_t m_wakeCount;
+  std::int64_t m_sleptUs;
+};
+
+} // namespace power
@@ -0,0 +1,62 @@
+#include <power/PowerManager.h>
+
+#include <Arduino.h>
+
+#include <driver/gpio.h>
+#include <esp_sleep.h>
+#include <esp_timer.h>
+
+#include <logging/Log.h>
+
+namespace power {
+
+PowerManager::PowerManager(const std::uint8_t wakePin)
+  : m_wakePin{wakePin}
+  , m_wakeCount{0U}
+  , m_sleptUs{0}
+{
+}
+
+bool
+PowerManager::lightSleep(const std::chrono::milliseconds duration)
+{
+  const auto pin{static_cast<gpio_num_t>(m_wakePin)};
+  if (digitalRead(m_wakePin) == HIGH) {
+    return true; // already pending, the edge interrupt may have been missed
+  }
+
+  logging::flush(); // the UART stops during light sleep
+
+  // the wakeup switches the pin to level triggering, the radio interrupt is edge triggered. It stays disabled until
+  // the edge triggering is restored, a level interrupt would fire until readData() clears the IRQ, which loop() never
+  // gets to. The caller handles the packet, so the lost edge does not matter.
+  gpio_intr_disable(pin);
+  gpio_wakeup_enable(pin, GPIO_INTR_HIGH_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+  esp_sleep_enable_timer_wakeup(static_cast<std::uint64_t>(std::chrono::microseconds{duration}.count()));
+
+  const auto sleepStart{esp_timer_get_time()};
+  esp_light_sleep_start();
+  m_sleptUs += esp_timer_get_time() - sleepStart;
+  ++m_wakeCount;
+
+  const bool wokenByPin{esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO};
+  esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);
+  gpio_wakeup_disable(pin);
+  gpio_set_intr_type(pin, GPIO_INTR_POSEDGE);
+  gpio_intr_enable(pin);
+
+  return wokenByPin;
+}
+
+PowerStatistics
+PowerManager::statistics() const
+{
+  return {
+    .wakeCount = m_wakeCount,
+    .awakeTime = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::microseconds{esp_timer_get_time() - m_sleptUs}),
+  };
+}
+
+} // namespace power
@@ -0,0 +1,88 @@
+// On-target build of the ingest benchmark, see test/ingest/IngestBenchmark.h. Built by the LilyGoT3S3-benchmark
+// environment instead of main.cpp, the results are printed on the serial monitor. The host build is the primary
+// one, this one adds the timing and heap of the gateway.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include <Arduino.h>
+
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+#include <ArduinoJson.h>
+
+#include <IngestBenchmark.h>
+#include <logging/Log.h>
+// the libraries used by IngestBenchmark.h, named here for the library dependency finder
+#include <airtime/Airtime.h>
+#include <crypto/KeyRing.hpp>
+#include <message/MessageProcessor.h>
+#include <packet/PacketDecoder.h>
+#include <packet/PacketEncoder.h>
+
+namespace {
+// NOLINTBEGIN(*-avoid-non-const-global-variables)
+
+std::size_t g_runStartFreeHeap{0U};
+std::size_t g_runMinFreeHeap{0U};
+
+// NOLINTEND(*-avoid-non-const-global-variables)
+
+std::size_t
+freeHeap()
+{
+  return heap_caps_get_free_size(MALLOC_CAP_8BIT);
+}
+
+struct TargetPlatform
+{
+  static int64_t nowUs()
+  {
+    return esp_timer_get_time();
+  }
+
+  static void startRun()
+  {
+    g_runStartFreeHeap = freeHeap();
+    g_runMinFreeHeap = g_runStartFreeHeap;
+  }
+
+  // the heap is sampled between packets, transient allocations while processing are not seen
+  static void afterPacket()
+  {
+    g_runMinFreeHeap = std::min(g_runMinFreeHeap, freeHeap());
+    yield();
+  }
+
+  static std::size_t heapHighWaterBytes()
+  {
+    return g_runStartFreeHeap - g_runMinFreeHeap;
+  }
+
+  // results bypass the logger, whose records are too short for them
+  static void print(const JsonDocument& doc)
+  {
+    logging::flush();
+    serializeJson(doc, Serial);
+    Serial.println();
+  }
+};
+} // namespace
+
+void
+setup()
+{
+  Serial.begin(115200);
+  delay(500);
+  logging::startDrainTask();
+
+  ingest::IngestBenchmark<TargetPlatform>::run();
+}
+
+void
+loop()
+{
+  delay(1000);
+}
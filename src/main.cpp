@@ -1,16 +1,32 @@
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <mutex>
+#include <optional>
 
 #include <Arduino.h>
 
+#include <esp_timer.h>
+
+#include <airtime/Airtime.h>
+#include <config/ConfigStore.h>
+#include <config/DiscoveryStore.h>
+#include <config/GatewayConfig.h>
+#include <logging/Log.h>
 #include <lora/LoraClient.h>
 #include <message/MessageProcessor.h>
+#include <message/Pipeline.h>
+#include <message/Stages.h>
 #include <mqtt/MqttClient.h>
+#include <power/PowerManager.h>
 #include <watchdog/Watchdog.h>
 
 using namespace std::chrono_literals;
 
 namespace {
+// factory defaults, used until a configuration has been received via MQTT
 constexpr auto g_wifiSsid{"xxxxx"};
 constexpr auto g_wifiPassword{"xxxxx"};
 constexpr auto g_mqttUsername{"xxxxx"};
@@ -18,40 +34,243 @@ constexpr auto g_mqttPassword{"xxxxx"};
 constexpr auto g_gatewayId{"xy"};
 constexpr auto g_mqttServer{"mqtt-server.lan"};
 constexpr std::uint16_t g_mqttPort{1883};
+constexpr message::ProcessorOptions g_processorOptions{
+  .publishLinkDiagnostics = false,
+  .discoveryMode = message::DiscoveryMode::PerEntity,
+  .stateMode = message::StateMode::PerKey,
+};
+constexpr std::chrono::milliseconds g_gatewayDiagnosticsInterval{1min};
+constexpr std::chrono::milliseconds g_networkChangeTimeout{2min};
+// pipeline filters, 0 disables them. Dedup is off as repeated events, e.g. a button pressed twice, are identical
+// packets too.
+constexpr std::chrono::milliseconds g_retransmissionWindow{0ms}; // same payload from the same node, e.g. 2s
+constexpr auto g_deadbandKey{"t"};
+constexpr double g_deadband{0.0}; // per key state mode only
+// low power mode: light sleep between packets, WiFi only on during periodic wake windows
+constexpr bool g_lowPowerMode{false};
+constexpr std::chrono::milliseconds g_wakeWindowInterval{5min};
+constexpr std::chrono::milliseconds g_wakeWindowDuration{3s};
+constexpr std::chrono::milliseconds g_wakeWindowConnectTimeout{15s};
+constexpr std::chrono::milliseconds g_maxLightSleep{10s}; // must stay below the watchdog timeout
+// > 0 enables duty cycled receive with preamble sniffing, the nodes have to send this preamble length
+constexpr std::uint16_t g_senderPreambleLength{0U};
+constexpr auto g_configNamespace{"gateway"};
+constexpr auto g_configTopicPrefix{"loragateway/"};
+constexpr auto g_configTopicSuffix{"/config"};
 
 constexpr crypto::Aes::Array
   g_aesKey{0xC5, 0xBD, 0x18, 0x6E, 0x98, 0xBE, 0x79, 0xF3, 0xFA, 0x98, 0xE3, 0x30, 0xF7, 0x1E, 0x4E, 0x93};
 
+// a named type instead of a lambda, so the processor and pipeline types can be spelled out for the globals
+struct MqttSink
+{
+  bool operator()(const char* topic, const char* payload, std::size_t length, bool retained) const;
+};
+
+using JsonProcessor = message::MessageProcessor<MqttSink>;
+// receiver (LoraClient) -> decoder -> filters -> publisher
+using IngestPipeline = message::Pipeline<message::JsonDecoder,
+                                         message::NodeAirtime,
+                                         message::MetricsTap,
+                                         message::DedupFilter,
+                                         message::DeadbandFilter,
+                                         message::MetricsTap,
+                                         message::Publisher<JsonProcessor>>;
+
+// low power mode: WiFi is switched on for a wake window every g_wakeWindowInterval
+enum class WakeWindow : uint8_t
+{
+  Closed,     // WiFi off, light sleep between packets
+  Connecting, // waiting for WiFi and MQTT, at most g_wakeWindowConnectTimeout
+  Open,       // connected for g_wakeWindowDuration
+};
+
 // NOLINTBEGIN(*-avoid-non-const-global-variables,*-err58-cpp)
 
 watchdog::Watchdog g_watchdog{20s};
-mqtt::MqttClient
-  g_mqttClient{g_wifiSsid, g_wifiPassword, g_mqttUsername, g_mqttPassword, g_gatewayId, g_mqttServer, g_mqttPort};
-lora::LoraClient g_loraClient{g_aesKey};
-message::MessageProcessor g_jsonProcessor{[](const String& topic, const String& payload, const bool retained) {
-                                            return g_mqttClient.publish(topic, payload, retained);
-                                          },
-                                          [] {
-                                            return g_loraClient.getRssi();
-                                          },
-                                          g_gatewayId};
+const config::ConfigStore g_configStore{g_configNamespace};
+const config::DiscoveryStore g_discoveryStore{g_configNamespace};
+config::GatewayConfig g_config;
+// constructed in setup() once the configuration is loaded
+std::optional<mqtt::MqttClient> g_mqttClient;
+std::optional<lora::LoraClient> g_loraClient;
+std::optional<JsonProcessor> g_jsonProcessor;
+std::optional<IngestPipeline> g_pipeline;
+message::PipelineMetrics g_decodedMetrics;
+message::PipelineMetrics g_publishedMetrics;
+std::optional<power::PowerManager> g_powerManager;
+std::mutex g_pendingConfigMutex;
+std::optional<String> g_pendingConfig;
+uint32_t g_lastGatewayDiagnosticsMs{0U};
+uint32_t g_savedDiscoveryRevision{0U};
+WakeWindow g_wakeWindow{WakeWindow::Closed};
+uint32_t g_wakeWindowStateMs{0U};
 volatile bool g_messageReceived{false};
+// lower 32 bits only, 64 bit accesses are not atomic on the ESP32 and the ISR may write while loop() reads
+std::atomic<uint32_t> g_messageReceivedAtUs{0U};
 
 // NOLINTEND(*-avoid-non-const-global-variables,*-err58-cpp)
 
+bool
+MqttSink::operator()(const char* const topic,
+                     const char* const payload,
+                     const std::size_t length,
+                     const bool retained) const
+{
+  return g_mqttClient->publish(topic, payload, length, retained);
+}
+
 ICACHE_RAM_ATTR
 void
 messageReceived()
 {
+  g_messageReceivedAtUs.store(static_cast<uint32_t>(esp_timer_get_time()), std::memory_order_relaxed);
   g_messageReceived = true;
 }
 
+// Extends the 32 bit timestamp written by the ISR, valid as long as the packet is read within ~71 minutes.
+int64_t
+messageReceivedAtUs()
+{
+  const int64_t now{esp_timer_get_time()};
+  const uint32_t elapsedUs{static_cast<uint32_t>(now) - g_messageReceivedAtUs.load(std::memory_order_relaxed)};
+  return now - elapsedUs;
+}
+
+void
+loadConfig()
+{
+  if (auto stored{g_configStore.load()}) {
+    g_config = std::move(*stored);
+    return;
+  }
+
+  g_config = {
+    .wifiSsid = g_wifiSsid,
+    .wifiPassword = g_wifiPassword,
+    .mqttUsername = g_mqttUsername,
+    .mqttPassword = g_mqttPassword,
+    .gatewayId = g_gatewayId,
+    .mqttServer = g_mqttServer,
+    .mqttPort = g_mqttPort,
+    .aesKey = g_aesKey,
+    .previousAesKey = std::nullopt,
+    .nodeKeys = {},
+  };
+}
+
+void
+initClients()
+{
+  g_mqttClient.emplace(g_config.wifiSsid,
+                       g_config.wifiPassword,
+                       g_config.mqttUsername,
+                       g_config.mqttPassword,
+                       g_config.gatewayId,
+                       g_config.mqttServer,
+                       g_config.mqttPort);
+  g_loraClient.emplace(config::makeKeyRing(g_config), g_config.gatewayId);
+  if (g_lowPowerMode) {
+    g_mqttClient->setPowerSaving(true);
+    g_powerManager.emplace(g_loraClient->interruptPin());
+  }
+  g_jsonProcessor.emplace(MqttSink{}, g_config.gatewayId, g_processorOptions);
+  g_jsonProcessor->restoreDiscoveredKeys(g_discoveryStore.load());
+  g_savedDiscoveryRevision = g_jsonProcessor->discoveryRevision();
+  g_pipeline.emplace(message::JsonDecoder{g_config.gatewayId, g_processorOptions.publishLinkDiagnostics},
+                     message::NodeAirtime{g_processorOptions.publishLinkDiagnostics},
+                     message::MetricsTap{g_decodedMetrics},
+                     message::DedupFilter{g_retransmissionWindow},
+                     message::DeadbandFilter{g_deadbandKey, g_deadband},
+                     message::MetricsTap{g_publishedMetrics},
+                     message::Publisher{*g_jsonProcessor});
+
+  // retained, so the current configuration is delivered on every (re)connect
+  g_mqttClient->subscribe(String{g_configTopicPrefix} + g_config.gatewayId + g_configTopicSuffix,
+                          [](const char*, const char* const payload) {
+                            const std::lock_guard lock{g_pendingConfigMutex};
+                            g_pendingConfig = String{payload};
+                          });
+}
+
+void
+applyPendingConfig()
+{
+  std::optional<String> payload;
+  {
+    const std::lock_guard lock{g_pendingConfigMutex};
+    payload.swap(g_pendingConfig);
+  }
+  if (not payload) {
+    return;
+  }
+
+  const auto updated{config::applyJson(g_config, payload->c_str())};
+  if (not updated) {
+    LOG_ERROR("Invalid configuration received");
+    return;
+  }
+  if (*updated == g_config) {
+    return;
+  }
+
+  const bool restart{config::requiresRestart(g_config, *updated)};
+  if (restart) {
+    if (const auto rejected{g_configStore.load(config::ConfigSlot::Rejected)}; rejected and *rejected == *updated) {
+      LOG_WARNING("Configuration did not connect before, ignored");
+      return;
+    }
+    // connectMqtt() restores the current configuration if the updated one does not connect
+    if (not g_configStore.save(g_config, config::ConfigSlot::Fallback)) {
+      return;
+    }
+  }
+  if (not g_configStore.save(*updated)) {
+    return;
+  }
+
+  if (restart) {
+    LOG_INFO("Configuration changed, restarting");
+    logging::flush();
+    ESP.restart();
+  }
+
+  g_config = *updated;
+  g_loraClient->setKeyRing(config::makeKeyRing(g_config));
+  LOG_INFO("AES keys updated");
+}
+
+// A network change is tried once after the restart. If it does not connect, the previous configuration is restored
+// and the change is remembered, so the retained configuration message does not apply it again.
+void
+connectMqtt()
+{
+  const auto fallback{g_configStore.load(config::ConfigSlot::Fallback)};
+  if (not fallback) {
+    g_mqttClient->connect(); // the configuration has connected before, retried until the network is back
+    return;
+  }
+
+  if (g_mqttClient->connect(g_networkChangeTimeout)) {
+    g_configStore.clear(config::ConfigSlot::Fallback);
+    g_configStore.clear(config::ConfigSlot::Rejected);
+    return;
+  }
+
+  LOG_ERROR("Configuration does not connect, restoring the previous one");
+  if (g_configStore.save(g_config, config::ConfigSlot::Rejected) and g_configStore.save(*fallback)) {
+    g_configStore.clear(config::ConfigSlot::Fallback);
+  }
+  logging::flush();
+  ESP.restart();
+}
+
 void
 initLoRa()
 {
-  g_loraClient.setPacketReceivedAction(messageReceived);
+  g_loraClient->setPacketReceivedAction(messageReceived);
 
-  if (not g_loraClient.begin()) {
+  if (not g_loraClient->begin()) {
     // ReSharper disable once CppDFAEndlessLoop
     while (true) {
       yield();
@@ -62,11 +281,113 @@ initLoRa()
 void
 initRandom()
 {
-  const std::int32_t value{g_loraClient.randomInt()};
+  const std::int32_t value{g_loraClient->randomInt()};
   randomSeed(value);
   srand(value);
 }
 
+void
+publishGatewayDiagnostics()
+{
+  const auto now{millis()};
+  if (now - g_lastGatewayDiagnosticsMs < g_gatewayDiagnosticsInterval.count()) {
+    return;
+  }
+  g_lastGatewayDiagnosticsMs = now;
+  // the difference are the packets dropped by the filters
+  LOG_INFO("Packets decoded", static_cast<int32_t>(g_decodedMetrics.packets));
+  LOG_INFO("Packets published", static_cast<int32_t>(g_publishedMetrics.packets));
+
+  const float utilisation{g_loraClient->channelAirtime().utilisation(g_loraClient->frequencyMhz(), now)};
+  JsonDocument doc;
+  doc["cu"] = utilisation * 100.0F;
+  doc["cp"] = airtime::collisionProbability(utilisation) * 100.0F;
+  if (g_powerManager) {
+    const auto statistics{g_powerManager->statistics()};
+    doc["wk"] = statistics.wakeCount;
+    doc["awk"] = std::chrono::duration_cast<std::chrono::seconds>(statistics.awakeTime).count();
+    doc["wot"] = std::chrono::duration_cast<std::chrono::seconds>(g_mqttClient->wifiOnTime()).count();
+  }
+  // since boot, including the diagnostics themselves
+  if (const auto& statistics{g_jsonProcessor->statistics()}; statistics.packets > 0U) {
+    doc["pp"] = static_cast<float>(statistics.publishes) / static_cast<float>(statistics.packets);
+    doc["bp"] = static_cast<float>(statistics.publishedBytes) / static_cast<float>(statistics.packets);
+  }
+  g_jsonProcessor->publishGatewayDiagnostics(doc);
+}
+
+// written only when a node reports a key for the first time, so the flash is not worn out. A failed save is retried
+// with the next change instead of on every loop.
+void
+saveDiscoveredKeys()
+{
+  const auto revision{g_jsonProcessor->discoveryRevision()};
+  if (revision == g_savedDiscoveryRevision) {
+    return;
+  }
+  g_savedDiscoveryRevision = revision;
+  g_discoveryStore.save(g_jsonProcessor->discoveredKeys());
+}
+
+void
+startReceive()
+{
+  if (g_senderPreambleLength > 0U) {
+    g_loraClient->startReceiveDutyCycle(g_senderPreambleLength);
+  } else {
+    g_loraClient->startReceive();
+  }
+}
+
+void
+closeWakeWindow()
+{
+  g_mqttClient->flush();
+  g_mqttClient->disconnect();
+  g_wakeWindow = WakeWindow::Closed;
+  g_wakeWindowStateMs = millis();
+}
+
+// Steps the wake window without blocking, so received packets are still handled while WiFi is on. The gateway only
+// sleeps while the window is closed.
+void
+serviceWakeWindow()
+{
+  const auto now{millis()};
+  const auto inState{now - g_wakeWindowStateMs};
+  switch (g_wakeWindow) {
+    case WakeWindow::Closed:
+      if (inState >= g_wakeWindowInterval.count()) {
+        g_mqttClient->startConnect();
+        g_wakeWindow = WakeWindow::Connecting;
+        g_wakeWindowStateMs = now;
+      } else if (not g_messageReceived) {
+        const std::chrono::milliseconds untilWakeWindow{g_wakeWindowInterval.count() - inState};
+        g_watchdog.reset();
+        if (g_powerManager->lightSleep(std::min(untilWakeWindow, g_maxLightSleep))) {
+          messageReceived(); // the edge interrupt is not delivered during light sleep
+        }
+      }
+      break;
+    case WakeWindow::Connecting:
+      if (g_mqttClient->pollConnect()) {
+        g_mqttClient->flush();
+        g_wakeWindow = WakeWindow::Open;
+        g_wakeWindowStateMs = now;
+      } else if (inState >= g_wakeWindowConnectTimeout.count()) {
+        LOG_WARNING("Wake window connect timed out");
+        closeWakeWindow();
+      }
+      break;
+    case WakeWindow::Open:
+      // gives the broker some time to deliver the retained configuration, applied by loop()
+      if (inState >= g_wakeWindowDuration.count()) {
+        closeWakeWindow();
+      }
+      break;
+  }
+}
+
 } // namespace
 
 void
@@ -74,14 +395,24 @@ setup()
 {
   Serial.begin(115200);
   delay(500);
+  logging::startDrainTask();
+
+  loadConfig();
+  initClients();
 
   initLoRa();
 
   initRandom();
 
-  g_mqttClient.connect();
-  g_loraClient.startReceive();
+  connectMqtt();
+  startReceive();
   g_watchdog.start();
+
+  if (g_lowPowerMode) {
+    // the first wake window starts with the connection made above
+    g_wakeWindow = WakeWindow::Open;
+    g_wakeWindowStateMs = millis();
+  }
 }
 
 void
@@ -92,8 +423,17 @@ loop()
   if (g_messageReceived) {
     g_messageReceived = false;
 
-    if (const auto message{g_loraClient.receiveMessage()}) {
-      g_jsonProcessor.processMessage(message.value());
+    if (auto packet{g_loraClient->receiveMessage(messageReceivedAtUs())}) {
+      message::PipelineContext context{std::move(*packet)};
+      g_pipeline->process(context);
     }
   }
+
+  applyPendingConfig();
+  publishGatewayDiagnostics();
+  saveDiscoveredKeys();
+
+  if (g_powerManager) {
+    serviceWakeWindow();
+  }
 }
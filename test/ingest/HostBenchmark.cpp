@@ -0,0 +1,58 @@
+// Host build of the ingest benchmark, see IngestBenchmark.h. Built by the benchmark environment:
+//   pio run -e benchmark && .pio/build/benchmark/program
+// The heap high water mark comes from the allocation counting of the harness.
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "IngestBenchmark.h"
+#include "IngestHarness.h"
+
+namespace {
+int64_t g_baselineBytes{0}; // NOLINT(*-avoid-non-const-global-variables)
+
+struct HostPlatform
+{
+  static int64_t nowUs()
+  {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+  }
+
+  static void startRun()
+  {
+    g_baselineBytes = ingest::g_allocations.liveBytes;
+    ingest::g_allocations.peakBytes = ingest::g_allocations.liveBytes;
+  }
+
+  static void afterPacket()
+  {
+  }
+
+  static std::size_t heapHighWaterBytes()
+  {
+    return static_cast<std::size_t>(ingest::g_allocations.peakBytes - g_baselineBytes);
+  }
+
+  static void print(const JsonDocument& doc)
+  {
+    std::string output;
+    serializeJson(doc, output);
+    std::puts(output.c_str());
+  }
+};
+} // namespace
+
+int
+main(int, char**)
+{
+#if not INGEST_COUNT_ALLOCATIONS
+  std::fputs("heap_high_water needs glibc, it is reported as 0\n", stderr);
+#endif
+  ingest::IngestBenchmark<HostPlatform>::run();
+  return 0;
+}
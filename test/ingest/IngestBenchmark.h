@@ -0,0 +1,362 @@
+#pragma once
+
+// Ingest benchmark, built for the host by the benchmark environment (HostBenchmark.cpp) and optionally for the
+// gateway by the LilyGoT3S3-benchmark environment (src/benchmark).
+//
+// Synthetic node populations send encrypted packets that go through the real decode, pipeline and publish code.
+// Arrivals are scheduled in virtual time, the processing time of each packet is measured and the broker latency is
+// added per publish. A packet is dropped if it arrives while the gateway is still busy with the previous one, as the
+// radio only holds a single packet. Every population runs for each combination of discovery mode, state mode and
+// broker latency. The results are printed as one JSON object per line, so they can be collected and compared
+// between builds.
+//
+// TPlatform provides the clock, the heap measurement and the output as static functions:
+//   int64_t nowUs()                     monotonic time
+//   void startRun()                     called before the gateway side of a run is set up
+//   void afterPacket()                  called after every packet, outside the measured time
+//   std::size_t heapHighWaterBytes()    most heap used since startRun()
+//   void print(const JsonDocument& doc) outputs one result
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <ArduinoJson.h>
+
+#include <airtime/Airtime.h>
+#include <crypto/Aes.hpp>
+#include <crypto/KeyRing.hpp>
+#include <message/HomeAssistant.h>
+#include <message/MessageProcessor.h>
+#include <message/Pipeline.h>
+#include <message/Stages.h>
+#include <packet/PacketDecoder.h>
+#include <packet/PacketEncoder.h>
+
+namespace ingest {
+template<typename TPlatform>
+class IngestBenchmark
+{
+public:
+  static constexpr auto gatewayId{"bench"};
+  static constexpr uint32_t seed{1U}; // same seed, same populations and payloads
+  static constexpr std::array<std::size_t, 7U> populations{8U, 16U, 32U, 64U, 128U, 256U, 512U};
+  static constexpr uint32_t sendIntervalS{60U};
+  static constexpr uint32_t sendJitterPercent{5U};
+  static constexpr uint32_t roundsPerRun{4U};
+  static constexpr std::size_t maxKeysPerNode{4U};
+  static constexpr crypto::KeyRing::KeyId keyIds{4U}; // nodes are spread over this many keys
+  static constexpr std::array<uint32_t, 3U> brokerLatenciesUs{0U, 2000U, 10000U}; // 0: processing time only
+  static constexpr std::array<message::DiscoveryMode, 2U> discoveryModes{message::DiscoveryMode::PerEntity,
+                                                                         message::DiscoveryMode::PerDevice};
+  static constexpr std::array<message::StateMode, 2U> stateModes{message::StateMode::PerKey,
+                                                                 message::StateMode::Aggregated};
+  static constexpr float maxDropRate{0.01F}; // a population is supported up to this share of dropped packets
+
+  static void run()
+  {
+    for (const auto brokerLatencyUs : brokerLatenciesUs) {
+      for (const auto discoveryMode : discoveryModes) {
+        for (const auto stateMode : stateModes) {
+          const RunConfig config{
+            .options = {.publishLinkDiagnostics = false, .discoveryMode = discoveryMode, .stateMode = stateMode},
+            .brokerLatencyUs = brokerLatencyUs,
+          };
+          runPopulations(config);
+        }
+      }
+    }
+  }
+
+private:
+  struct RunConfig
+  {
+    message::ProcessorOptions options;
+    uint32_t brokerLatencyUs;
+  };
+
+  struct Node
+  {
+    String id;
+    crypto::KeyRing::KeyId keyId;
+    std::vector<std::size_t> keys; // discovery info indices
+  };
+
+  struct Arrival
+  {
+    int64_t timeUs; // virtual time at the end of the transmission
+    uint16_t node;
+  };
+
+  struct RunResult
+  {
+    std::size_t nodes;
+    uint32_t sent;
+    uint32_t dropped;
+    uint32_t p50Us;
+    uint32_t p99Us;
+    float channelUtilisation;
+    std::size_t heapHighWaterBytes; // state of the decoder, the stages and the processor included
+    message::ProcessorStatistics statistics;
+  };
+
+  // Acknowledges every publish, the latency of the broker is added in virtual time.
+  struct BrokerSink
+  {
+    bool operator()(const char*, const char*, std::size_t, bool) const
+    {
+      return true;
+    }
+  };
+
+  using Processor = message::MessageProcessor<BrokerSink>;
+  using IngestPipeline =
+    message::Pipeline<message::JsonDecoder, message::NodeAirtime, message::Publisher<Processor>>;
+
+  static crypto::KeyRing makeKeyRing()
+  {
+    crypto::KeyRing keyRing;
+    for (crypto::KeyRing::KeyId keyId{0U}; keyId < keyIds; ++keyId) {
+      crypto::Aes::Array key{};
+      std::fill(key.begin(), key.end(), static_cast<byte>(0xA5U ^ keyId));
+      keyRing.set(keyId, key);
+    }
+    return keyRing;
+  }
+
+  // the keys a node can send, gateway keys would be dropped by the decoder
+  static std::vector<std::size_t> nodeKeys()
+  {
+    std::vector<std::size_t> keys;
+    for (std::size_t index{0U}; index < message::discoveryInfoCount(); ++index) {
+      if (not message::isGatewayKey(index)) {
+        keys.push_back(index);
+      }
+    }
+    return keys;
+  }
+
+  static std::vector<Node> makeNodes(const std::size_t count, std::minstd_rand& random)
+  {
+    const auto keys{nodeKeys()};
+    std::uniform_int_distribution<std::size_t> keyCount{1U, maxKeysPerNode};
+    std::uniform_int_distribution<std::size_t> keyIndex{0U, keys.size() - 1U};
+
+    std::vector<Node> nodes;
+    nodes.reserve(count);
+    for (std::size_t index{0U}; index < count; ++index) {
+      Node node{String{"node"} + index, static_cast<crypto::KeyRing::KeyId>(index % keyIds), {}};
+      for (std::size_t key{keyCount(random)}; key > 0U; --key) {
+        node.keys.push_back(keys[keyIndex(random)]);
+      }
+      nodes.push_back(std::move(node));
+    }
+    return nodes;
+  }
+
+  static String makePayload(const Node& node, std::minstd_rand& random)
+  {
+    std::uniform_int_distribution<long> value{0, 1000};
+
+    JsonDocument doc;
+    doc["k"] = gatewayId;
+    doc["id"] = node.id;
+    for (const auto index : node.keys) {
+      const char* const key{message::discoveryKey(index)};
+      switch (message::discoveryValueType(index)) {
+        case message::ValueType::Integer:
+          doc[key] = value(random);
+          break;
+        case message::ValueType::Float:
+          doc[key] = static_cast<double>(value(random)) / 10.0;
+          break;
+        case message::ValueType::String:
+          doc[key] = value(random) % 2 == 0 ? "on" : "off";
+          break;
+      }
+    }
+
+    String payload;
+    serializeJson(doc, payload);
+    return payload;
+  }
+
+  static std::vector<Arrival> scheduleArrivals(const std::size_t nodeCount, std::minstd_rand& random)
+  {
+    constexpr int64_t intervalUs{static_cast<int64_t>(sendIntervalS) * 1'000'000};
+    constexpr int64_t jitterUs{intervalUs * sendJitterPercent / 100};
+    std::uniform_int_distribution<int64_t> phase{0, intervalUs - 1};
+    std::uniform_int_distribution<int64_t> jitter{-jitterUs, jitterUs};
+
+    std::vector<Arrival> arrivals;
+    arrivals.reserve(nodeCount * roundsPerRun);
+    for (std::size_t node{0U}; node < nodeCount; ++node) {
+      const int64_t start{phase(random)};
+      for (uint32_t round{0U}; round < roundsPerRun; ++round) {
+        arrivals.push_back({start + (round * intervalUs) + jitter(random), static_cast<uint16_t>(node)});
+      }
+    }
+    std::sort(arrivals.begin(), arrivals.end(), [](const Arrival& lhs, const Arrival& rhs) {
+      return lhs.timeUs < rhs.timeUs;
+    });
+    return arrivals;
+  }
+
+  static uint32_t percentile(std::vector<uint32_t>& values, const std::size_t percent)
+  {
+    if (values.empty()) {
+      return 0U;
+    }
+    const auto nth{values.begin() + static_cast<std::ptrdiff_t>((values.size() - 1U) * percent / 100U)};
+    std::nth_element(values.begin(), nth, values.end());
+    return *nth;
+  }
+
+  static RunResult runPopulation(const std::size_t nodeCount, const RunConfig& config)
+  {
+    std::minstd_rand random{seed};
+    const auto nodes{makeNodes(nodeCount, random)};
+    const auto arrivals{scheduleArrivals(nodeCount, random)};
+    const packet::PacketEncoder encoder{makeKeyRing(), gatewayId};
+    std::vector<uint32_t> latencies;
+    latencies.reserve(arrivals.size());
+
+    TPlatform::startRun();
+    packet::PacketDecoder decoder{makeKeyRing(), gatewayId};
+    Processor processor{BrokerSink{}, gatewayId, config.options};
+    IngestPipeline pipeline{message::JsonDecoder{gatewayId, config.options.publishLinkDiagnostics},
+                            message::NodeAirtime{config.options.publishLinkDiagnostics},
+                            message::Publisher{processor}};
+
+    RunResult result{nodeCount, 0U, 0U, 0U, 0U, 0.0F, 0U, {}};
+    std::array<byte, packet::PacketDecoder::maxPacketLength> buffer{};
+    uint64_t airtimeUs{0U};
+    int64_t busyUntilUs{0};
+
+    for (const auto& arrival : arrivals) {
+      const auto payload{makePayload(nodes[arrival.node], random)};
+      const std::size_t length{encoder.encode(nodes[arrival.node].keyId,
+                                              reinterpret_cast<const byte*>(payload.c_str()),
+                                              payload.length(),
+                                              buffer.data())};
+      const uint32_t packetAirtimeUs{airtime::timeOnAirUs(airtime::g_gatewayModulation, length)};
+      ++result.sent;
+      airtimeUs += packetAirtimeUs;
+
+      if (length == 0U or arrival.timeUs < busyUntilUs) {
+        ++result.dropped;
+        continue;
+      }
+
+      const packet::PacketMetadata metadata{
+        .rssi = -90.0F,
+        .snr = 8.0F,
+        .frequencyError = 0.0F,
+        .timestampUs = TPlatform::nowUs(),
+        .airtimeUs = packetAirtimeUs,
+      };
+      const uint32_t publishesBefore{processor.statistics().publishes};
+      bool published{false};
+      if (auto received{decoder.decode(buffer.data(), length, metadata)}) {
+        message::PipelineContext context{std::move(*received)};
+        published = pipeline.process(context);
+      }
+      const uint32_t publishes{processor.statistics().publishes - publishesBefore};
+      const auto processingUs{static_cast<uint32_t>(TPlatform::nowUs() - metadata.timestampUs) +
+                              (publishes * config.brokerLatencyUs)};
+      TPlatform::afterPacket();
+
+      busyUntilUs = arrival.timeUs + processingUs;
+      if (published) {
+        latencies.push_back(processingUs);
+      } else {
+        ++result.dropped;
+      }
+    }
+
+    result.p50Us = percentile(latencies, 50U);
+    result.p99Us = percentile(latencies, 99U);
+    const int64_t durationUs{static_cast<int64_t>(sendIntervalS) * 1'000'000 * roundsPerRun};
+    result.channelUtilisation = static_cast<float>(airtimeUs) / static_cast<float>(durationUs);
+    result.heapHighWaterBytes = TPlatform::heapHighWaterBytes();
+    result.statistics = processor.statistics();
+    return result;
+  }
+
+  static const char* discoveryModeName(const message::DiscoveryMode mode)
+  {
+    switch (mode) {
+      case message::DiscoveryMode::PerEntity:
+        return "per_entity";
+      case message::DiscoveryMode::PerDevice:
+        return "per_device";
+    }
+    return "unknown";
+  }
+
+  static const char* stateModeName(const message::StateMode mode)
+  {
+    switch (mode) {
+      case message::StateMode::PerKey:
+        return "per_key";
+      case message::StateMode::Aggregated:
+        return "aggregated";
+    }
+    return "unknown";
+  }
+
+  static void addConfig(JsonDocument& doc, const RunConfig& config)
+  {
+    doc["benchmark"] = "ingest";
+    doc["discovery_mode"] = discoveryModeName(config.options.discoveryMode);
+    doc["state_mode"] = stateModeName(config.options.stateMode);
+    doc["broker_latency_us"] = config.brokerLatencyUs;
+  }
+
+  // Runs the populations in increasing size up to the first one with too many dropped packets, larger populations
+  // would drop even more.
+  static void runPopulations(const RunConfig& config)
+  {
+    std::size_t nodesSupported{0U};
+    for (const auto nodeCount : populations) {
+      const auto result{runPopulation(nodeCount, config)};
+      const float dropRate{result.sent == 0U ? 0.0F : static_cast<float>(result.dropped) / result.sent};
+
+      JsonDocument doc;
+      addConfig(doc, config);
+      doc["nodes"] = result.nodes;
+      doc["sent"] = result.sent;
+      doc["dropped"] = result.dropped;
+      doc["p50_us"] = result.p50Us;
+      doc["p99_us"] = result.p99Us;
+      doc["channel_utilisation"] = result.channelUtilisation;
+      doc["collision_probability"] = airtime::collisionProbability(result.channelUtilisation);
+      doc["heap_high_water"] = result.heapHighWaterBytes;
+      // per published packet, the aggregated state mode trades publishes for larger payloads
+      const auto packets{static_cast<float>(std::max(result.statistics.packets, uint32_t{1U}))};
+      doc["publishes_per_packet"] = static_cast<float>(result.statistics.publishes) / packets;
+      doc["bytes_per_packet"] = static_cast<float>(result.statistics.publishedBytes) / packets;
+      TPlatform::print(doc);
+
+      if (dropRate > maxDropRate) {
+        break;
+      }
+      nodesSupported = nodeCount;
+    }
+
+    JsonDocument summary;
+    addConfig(summary, config);
+    summary["seed"] = seed;
+    summary["send_interval_s"] = sendIntervalS;
+    summary["max_drop_rate"] = maxDropRate;
+    summary["nodes_supported"] = nodesSupported;
+    TPlatform::print(summary);
+  }
+};
+} // namespace ingest
@@ -0,0 +1,35 @@
+// libFuzzer entry point for the ingest path, see IngestHarness.h for the input format. Built by the fuzz
+// environment, which needs clang:
+//   pio run -e fuzz && .pio/build/fuzz/program -max_len=300 test/ingest/corpus
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+
+#define INGEST_FUZZER
+#include "IngestHarness.h"
+
+extern "C" int
+LLVMFuzzerTestOneInput(const uint8_t* const data, const std::size_t size)
+{
+  // kept across inputs, so the per node state of the stages fills up like on the gateway
+  static std::array<std::optional<ingest::Harness>, ingest::g_optionCombinations> harnesses;
+  if (size == 0U) {
+    return 0;
+  }
+
+  const std::size_t options{(data[0] >> 1U) % ingest::g_optionCombinations};
+  auto& harness{harnesses[options]};
+  if (not harness) {
+    harness.emplace(static_cast<uint8_t>(options << 1U));
+  }
+
+  if (const auto result{harness->process(data, size)}; result.violation != nullptr) {
+    fprintf(stderr, "invariant violated: %s\n", result.violation);
+    abort();
+  }
+  return 0;
+}
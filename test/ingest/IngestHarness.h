@@ -0,0 +1,291 @@
+#pragma once
+
+// Drives fuzz inputs through the receive path of the gateway on the host: PacketDecoder -> JsonDecoder
+// (decodeNodeMessage) -> MessageProcessor with a fake MQTT sink, and checks the invariants that have to hold for
+// any packet. Shared by the Unity tests and the libFuzzer entry point.
+//
+// Fuzz input: one control byte, then the data.
+//   bit 0: 0 = the data is the plaintext of a node packet and gets encrypted with the node key, so the fuzzer
+//          reaches the JSON handling; 1 = the data is a raw packet as received by the radio
+//   bit 1: DiscoveryMode::PerDevice instead of PerEntity
+//   bit 2: StateMode::Aggregated instead of PerKey
+//   bit 3: link diagnostics enabled
+//
+// Allocations are counted by replacing malloc() on glibc, which also covers operator new and ArduinoJson. Include
+// this header in exactly one translation unit.
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include <ArduinoJson.h>
+
+#include <crypto/Aes.hpp>
+#include <crypto/KeyRing.hpp>
+#include <message/HomeAssistant.h>
+#include <message/MessageProcessor.h>
+#include <message/Pipeline.h>
+#include <message/Stages.h>
+#include <packet/PacketDecoder.h>
+#include <packet/PacketEncoder.h>
+
+#if defined(__GLIBC__) and not defined(INGEST_FUZZER)
+#include <malloc.h>
+#define INGEST_COUNT_ALLOCATIONS 1
+#else
+// the fuzzer runs with ASan, which owns malloc(), its -malloc_limit_mb bounds single allocations instead
+#define INGEST_COUNT_ALLOCATIONS 0
+#endif
+
+namespace ingest {
+constexpr auto g_gatewayId{"fuzz"};
+constexpr crypto::KeyRing::KeyId g_nodeKeyId{1U};
+constexpr crypto::Aes::Array
+  g_gatewayKey{0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F};
+constexpr crypto::Aes::Array
+  g_nodeKey{0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F};
+constexpr crypto::Aes::Array
+  g_previousNodeKey{0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F};
+
+constexpr uint8_t g_rawPacket{0x01U};
+constexpr uint8_t g_perDevice{0x02U};
+constexpr uint8_t g_aggregated{0x04U};
+constexpr uint8_t g_linkDiagnostics{0x08U};
+constexpr std::size_t g_optionCombinations{8U}; // bits 1 - 3
+
+// Invariants, generous enough for the largest valid packet but far below the heap of the gateway.
+constexpr std::size_t g_maxPublishesPerPacket{2U * message::g_maxDiscoveryInfos};
+constexpr std::size_t g_maxTopicLength{128U};
+constexpr std::size_t g_maxPayloadLength{16U * 1024U}; // device discovery config with all keys
+constexpr std::size_t g_maxAllocationsPerPacket{1024U};
+constexpr std::size_t g_maxPeakBytesPerPacket{64U * 1024U};
+constexpr std::size_t g_maxRetainedBytes{512U * 1024U}; // per node state of all stages for their maxNodes nodes
+
+struct AllocationStatistics
+{
+  std::size_t count{0U};
+  int64_t liveBytes{0};
+  int64_t peakBytes{0};
+};
+
+inline AllocationStatistics g_allocations; // NOLINT(*-avoid-non-const-global-variables)
+
+inline void
+recordAllocation(const std::size_t size)
+{
+  ++g_allocations.count;
+  g_allocations.liveBytes += static_cast<int64_t>(size);
+  g_allocations.peakBytes = std::max(g_allocations.peakBytes, g_allocations.liveBytes);
+}
+
+inline void
+recordRelease(const std::size_t size)
+{
+  g_allocations.liveBytes -= static_cast<int64_t>(size);
+}
+
+// Checks every MQTT message instead of sending it.
+class FakeSink
+{
+public:
+  std::size_t* publishes;
+  const char** violation;
+
+  bool operator()(const char* const topic, const char*, const std::size_t length, bool) const
+  {
+    ++*publishes;
+    const std::size_t topicLength{strlen(topic)};
+    if (topicLength == 0U or topicLength > g_maxTopicLength) {
+      *violation = "topic length out of bounds";
+    } else if (std::any_of(topic, topic + topicLength, [](const char character) {
+                 return character == '+' or character == '#' or static_cast<unsigned char>(character) < 0x20U;
+               })) {
+      *violation = "wildcard or control character in topic";
+    } else if (strstr(topic, "//") != nullptr) {
+      *violation = "empty topic level";
+    } else if (length > g_maxPayloadLength) {
+      *violation = "payload too long";
+    }
+    return true;
+  }
+};
+
+struct Result
+{
+  bool decoded;   // passed the PacketDecoder
+  bool published; // passed the whole pipeline
+  std::size_t publishes;
+  const char* violation; // nullptr if all invariants hold
+};
+
+class Harness
+{
+public:
+  explicit Harness(const uint8_t options)
+    : m_processor{FakeSink{&m_publishes, &m_violation}, g_gatewayId, processorOptions(options)}
+    , m_decoder{makeKeyRing(), g_gatewayId}
+    , m_pipeline{message::JsonDecoder{g_gatewayId, (options & g_linkDiagnostics) != 0U},
+                 message::NodeAirtime{(options & g_linkDiagnostics) != 0U},
+                 message::Publisher{m_processor}}
+  {
+  }
+
+  Result process(const uint8_t* const data, const std::size_t size)
+  {
+    if (size == 0U) {
+      return {false, false, 0U, nullptr};
+    }
+
+    std::array<byte, 2U * packet::PacketDecoder::maxPacketLength> buffer{};
+    // plaintexts that do not fit into a LoRa packet are truncated, so every input reaches the JSON handling
+    const std::size_t length{
+      (data[0] & g_rawPacket) != 0U
+        ? copyPacket(data + 1, size - 1U, buffer)
+        : m_encoder.encode(g_nodeKeyId, data + 1, std::min(size - 1U, m_encoder.maxPlaintextLength()), buffer.data())};
+
+    m_publishes = 0U;
+    m_violation = nullptr;
+    const auto allocationsBefore{g_allocations};
+    g_allocations.peakBytes = g_allocations.liveBytes;
+
+    Result result{false, false, 0U, nullptr};
+    const packet::PacketMetadata metadata{
+      .rssi = -90.0F,
+      .snr = 7.5F,
+      .frequencyError = 120.0F,
+      .timestampUs = 1'000'000,
+      .airtimeUs = 100'000U,
+    };
+    if (auto received{m_decoder.decode(buffer.data(), length, metadata)}) {
+      result.decoded = true;
+      if (received->message.length() > packet::PacketDecoder::maxPacketLength) {
+        m_violation = "decoded message longer than the packet";
+      }
+      message::PipelineContext context{std::move(*received)};
+      result.published = m_pipeline.process(context);
+    }
+
+    result.publishes = m_publishes;
+    result.violation = m_violation;
+    if (result.violation == nullptr and m_publishes > g_maxPublishesPerPacket) {
+      result.violation = "too many publishes";
+    }
+    if (INGEST_COUNT_ALLOCATIONS != 0 and result.violation == nullptr) {
+      if (g_allocations.count - allocationsBefore.count > g_maxAllocationsPerPacket) {
+        result.violation = "too many allocations";
+      } else if (g_allocations.peakBytes - allocationsBefore.liveBytes >
+                 static_cast<int64_t>(g_maxPeakBytesPerPacket)) {
+        result.violation = "too much memory allocated";
+      } else if (g_allocations.liveBytes - m_baselineBytes > static_cast<int64_t>(g_maxRetainedBytes)) {
+        result.violation = "retained memory grows without bound";
+      }
+    }
+    g_allocations.peakBytes = std::max(g_allocations.peakBytes, allocationsBefore.peakBytes);
+    return result;
+  }
+
+  [[nodiscard]] const message::ProcessorStatistics& statistics() const
+  {
+    return m_processor.statistics();
+  }
+
+  static crypto::KeyRing makeKeyRing()
+  {
+    crypto::KeyRing keyRing;
+    keyRing.set(0U, g_gatewayKey);
+    keyRing.set(g_nodeKeyId, g_nodeKey, g_previousNodeKey);
+    return keyRing;
+  }
+
+private:
+  using Processor = message::MessageProcessor<FakeSink>;
+
+  std::size_t m_publishes{0U};
+  const char* m_violation{nullptr};
+  Processor m_processor;
+  packet::PacketDecoder m_decoder;
+  message::Pipeline<message::JsonDecoder, message::NodeAirtime, message::Publisher<Processor>> m_pipeline;
+  packet::PacketEncoder m_encoder{makeKeyRing(), g_gatewayId};
+  int64_t m_baselineBytes{g_allocations.liveBytes};
+
+  static message::ProcessorOptions processorOptions(const uint8_t options)
+  {
+    return {
+      .publishLinkDiagnostics = (options & g_linkDiagnostics) != 0U,
+      .discoveryMode = (options & g_perDevice) != 0U ? message::DiscoveryMode::PerDevice
+                                                     : message::DiscoveryMode::PerEntity,
+      .stateMode = (options & g_aggregated) != 0U ? message::StateMode::Aggregated : message::StateMode::PerKey,
+    };
+  }
+
+  template<std::size_t TSize>
+  static std::size_t copyPacket(const uint8_t* const data, const std::size_t size, std::array<byte, TSize>& buffer)
+  {
+    std::copy_n(data, std::min(size, buffer.size()), buffer.begin());
+    // the decoder has to reject longer packets before reading past the buffer
+    return size;
+  }
+};
+} // namespace ingest
+
+#if INGEST_COUNT_ALLOCATIONS
+extern "C" {
+// the glibc implementations behind malloc() and friends
+void* __libc_malloc(std::size_t size) noexcept;
+void* __libc_calloc(std::size_t count, std::size_t size) noexcept;
+void* __libc_realloc(void* pointer, std::size_t size) noexcept;
+void __libc_free(void* pointer) noexcept;
+
+// NOLINTBEGIN(*-reserved-identifier,*-no-malloc,*-owning-memory)
+
+void*
+malloc(const std::size_t size) noexcept
+{
+  void* const pointer{__libc_malloc(size)};
+  if (pointer != nullptr) {
+    ingest::recordAllocation(malloc_usable_size(pointer));
+  }
+  return pointer;
+}
+
+void*
+calloc(const std::size_t count, const std::size_t size) noexcept
+{
+  void* const pointer{__libc_calloc(count, size)};
+  if (pointer != nullptr) {
+    ingest::recordAllocation(malloc_usable_size(pointer));
+  }
+  return pointer;
+}
+
+void*
+realloc(void* const pointer, const std::size_t size) noexcept
+{
+  const std::size_t oldSize{pointer != nullptr ? malloc_usable_size(pointer) : 0U};
+  void* const reallocated{__libc_realloc(pointer, size)};
+  if (reallocated != nullptr or size == 0U) {
+    ingest::recordRelease(oldSize);
+  }
+  if (reallocated != nullptr) {
+    ingest::recordAllocation(malloc_usable_size(reallocated));
+  }
+  return reallocated;
+}
+
+void
+free(void* const pointer) noexcept
+{
+  if (pointer != nullptr) {
+    ingest::recordRelease(malloc_usable_size(pointer));
+  }
+  __libc_free(pointer);
+}
+
+// NOLINTEND(*-reserved-identifier,*-no-malloc,*-owning-memory)
+}
+#endif
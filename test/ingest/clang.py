@@ -0,0 +1,9 @@
+# Switches the fuzz environment to clang with libFuzzer and the sanitizers, the native platform uses the default
+# host compiler otherwise.
+Import("env")  # noqa: F821
+
+env.Replace(CC="clang", CXX="clang++")  # noqa: F821
+env.Append(  # noqa: F821
+    CCFLAGS=["-fsanitize=fuzzer,address,undefined", "-g"],
+    LINKFLAGS=["-fsanitize=fuzzer,address,undefined"],
+)
@@ -0,0 +1,196 @@
+#pragma once
+
+// Minimal Arduino API for the host tests, only what the libraries under test use. String mimics the Arduino class
+// closely enough for ArduinoJson (ARDUINOJSON_ENABLE_ARDUINO_STRING), like the shim in ArduinoJson's own tests.
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using byte = uint8_t;
+
+class String
+{
+public:
+  String() = default;
+
+  String(const char* const string) // NOLINT(google-explicit-constructor)
+  {
+    if (string != nullptr) {
+      m_string.assign(string);
+    }
+  }
+
+  String(const char* const string, const std::size_t length)
+    : m_string{string, length}
+  {
+  }
+
+  explicit String(const int value)
+    : m_string{std::to_string(value)}
+  {
+  }
+
+  explicit String(const unsigned int value)
+    : m_string{std::to_string(value)}
+  {
+  }
+
+  explicit String(const long value)
+    : m_string{std::to_string(value)}
+  {
+  }
+
+  explicit String(const unsigned long value)
+    : m_string{std::to_string(value)}
+  {
+  }
+
+  String(const double value, const unsigned int decimals)
+  {
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), "%.*f", static_cast<int>(decimals), value);
+    m_string.assign(buffer);
+  }
+
+  String& operator=(const char* const string)
+  {
+    if (string != nullptr) {
+      m_string.assign(string);
+    } else {
+      m_string.clear();
+    }
+    return *this;
+  }
+
+  unsigned char concat(const char* const string)
+  {
+    m_string.append(string);
+    return 1U;
+  }
+
+  unsigned char concat(const String& string)
+  {
+    m_string.append(string.m_string);
+    return 1U;
+  }
+
+  unsigned char concat(const std::size_t value)
+  {
+    m_string.append(std::to_string(value));
+    return 1U;
+  }
+
+  String& operator+=(const char* const string)
+  {
+    concat(string);
+    return *this;
+  }
+
+  String& operator+=(const String& string)
+  {
+    concat(string);
+    return *this;
+  }
+
+  [[nodiscard]] const char* c_str() const
+  {
+    return m_string.c_str();
+  }
+
+  [[nodiscard]] unsigned int length() const
+  {
+    return static_cast<unsigned int>(m_string.length());
+  }
+
+  [[nodiscard]] bool isEmpty() const
+  {
+    return m_string.empty();
+  }
+
+  char operator[](const std::size_t index) const
+  {
+    return index < m_string.length() ? m_string[index] : '\0';
+  }
+
+  bool operator==(const String& other) const
+  {
+    return m_string == other.m_string;
+  }
+
+  bool operator!=(const String& other) const
+  {
+    return m_string != other.m_string;
+  }
+
+  bool operator==(const char* const other) const
+  {
+    return m_string == other;
+  }
+
+  bool operator!=(const char* const other) const
+  {
+    return m_string != other;
+  }
+
+  bool operator<(const String& other) const
+  {
+    return m_string < other.m_string;
+  }
+
+private:
+  std::string m_string;
+};
+
+// Arduino returns a StringSumHelper from operator+, ArduinoJson refers to it.
+class StringSumHelper : public String
+{
+public:
+  using String::String;
+
+  StringSumHelper(String string) // NOLINT(google-explicit-constructor)
+    : String{std::move(string)}
+  {
+  }
+};
+
+inline StringSumHelper
+operator+(const String& lhs, const String& rhs)
+{
+  String sum{lhs};
+  sum.concat(rhs);
+  return sum;
+}
+
+inline StringSumHelper
+operator+(const String& lhs, const char* const rhs)
+{
+  String sum{lhs};
+  sum.concat(rhs);
+  return sum;
+}
+
+inline StringSumHelper
+operator+(const String& lhs, const std::size_t rhs)
+{
+  String sum{lhs};
+  sum.concat(rhs);
+  return sum;
+}
+
+inline unsigned long
+millis()
+{
+  return static_cast<unsigned long>(
+    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+inline long
+random(const long min, const long max)
+{
+  return min < max ? min + (std::rand() % (max - min)) : min;
+}
@@ -0,0 +1,171 @@
+#include <cstdint>
+
+#include <unity.h>
+
+#include <airtime/Airtime.h>
+#include <airtime/DutyCycleAccountant.h>
+
+namespace {
+constexpr float g_frequencyMhz{868.1F};      // 868.0 - 868.6 MHz, 1 %
+constexpr float g_otherFrequencyMhz{869.5F}; // 869.4 - 869.65 MHz, 10 %
+constexpr float g_outsideFrequencyMhz{870.5F};
+constexpr uint64_t g_oneHourUs{3'600'000'000U};
+
+airtime::Modulation
+modulation(const uint8_t spreadingFactor, const float bandwidthKhz = 125.0F)
+{
+  return {
+    .spreadingFactor = spreadingFactor,
+    .bandwidthKhz = bandwidthKhz,
+    .codingRate = 5U,
+    .preambleLength = 8U,
+    .explicitHeader = true,
+    .crc = true,
+  };
+}
+} // namespace
+
+void
+setUp()
+{
+}
+
+void
+tearDown()
+{
+}
+
+// reference values from the Semtech LoRa calculator, BW 125 kHz, CR 4/5, preamble 8, explicit header, CRC on
+void
+testTimeOnAirMatchesSemtechCalculator()
+{
+  TEST_ASSERT_EQUAL_UINT32(56'576U, airtime::timeOnAirUs(modulation(7U), 20U));
+  TEST_ASSERT_EQUAL_UINT32(1'318'912U, airtime::timeOnAirUs(modulation(12U), 20U));
+}
+
+// SF5 and SF6 have 6.25 sync symbols and no extra 8 bits in the payload symbol count
+void
+testTimeOnAirShortSpreadingFactors()
+{
+  TEST_ASSERT_EQUAL_UINT32(12'096U, airtime::timeOnAirUs(modulation(5U), 10U));
+  TEST_ASSERT_EQUAL_UINT32(21'632U, airtime::timeOnAirUs(modulation(6U), 10U));
+}
+
+void
+testTimeOnAirGrowsWithPayload()
+{
+  const auto sf8{modulation(8U)};
+  TEST_ASSERT_TRUE(airtime::timeOnAirUs(sf8, 50U) > airtime::timeOnAirUs(sf8, 10U));
+}
+
+void
+testLowDataRateOptimizeSwitchesAt16Ms()
+{
+  TEST_ASSERT_FALSE(airtime::lowDataRateOptimize(modulation(10U)));
+  TEST_ASSERT_TRUE(airtime::lowDataRateOptimize(modulation(11U)));
+  TEST_ASSERT_TRUE(airtime::lowDataRateOptimize(modulation(12U)));
+  TEST_ASSERT_FALSE(airtime::lowDataRateOptimize(modulation(11U, 250.0F)));
+  TEST_ASSERT_TRUE(airtime::lowDataRateOptimize(modulation(12U, 250.0F)));
+  TEST_ASSERT_EQUAL_UINT32(16'384U, airtime::symbolTimeUs(modulation(11U)));
+}
+
+void
+testCollisionProbability()
+{
+  TEST_ASSERT_EQUAL_FLOAT(0.0F, airtime::collisionProbability(0.0F));
+  TEST_ASSERT_EQUAL_FLOAT(0.0F, airtime::collisionProbability(-1.0F));
+  TEST_ASSERT_FLOAT_WITHIN(1e-4F, 0.18127F, airtime::collisionProbability(0.1F));
+}
+
+void
+testSubBands()
+{
+  TEST_ASSERT_EQUAL_FLOAT(0.01F, airtime::subBandFor(g_frequencyMhz)->dutyCycle);
+  TEST_ASSERT_EQUAL_FLOAT(0.1F, airtime::subBandFor(g_otherFrequencyMhz)->dutyCycle);
+  TEST_ASSERT_NULL(airtime::subBandFor(g_outsideFrequencyMhz));
+}
+
+void
+testSlidingWindowExpiresBuckets()
+{
+  airtime::SlidingWindow window;
+  window.record(1'000U, 0U);
+  window.record(2'000U, airtime::SlidingWindow::bucketMs);
+
+  TEST_ASSERT_EQUAL_UINT64(3'000U, window.totalUs(airtime::SlidingWindow::windowMs - 1U));
+  TEST_ASSERT_EQUAL_UINT64(2'000U, window.totalUs(airtime::SlidingWindow::windowMs));
+  TEST_ASSERT_EQUAL_UINT64(0U, window.totalUs(airtime::SlidingWindow::windowMs + airtime::SlidingWindow::bucketMs));
+}
+
+void
+testSlidingWindowReusesBucketsAfterLongIdle()
+{
+  airtime::SlidingWindow window;
+  window.record(1'000U, 0U);
+  // the bucket that held the first record is reused much later
+  const uint32_t later{airtime::SlidingWindow::windowMs * 3U};
+  window.record(500U, later);
+
+  TEST_ASSERT_EQUAL_UINT64(500U, window.totalUs(later));
+}
+
+void
+testSlidingWindowSurvivesMillisWrap()
+{
+  airtime::SlidingWindow window;
+  const uint32_t beforeWrap{UINT32_MAX - 999U};
+  const uint32_t afterWrap{500U};
+  window.record(1'000U, beforeWrap);
+  window.record(2'000U, afterWrap);
+
+  TEST_ASSERT_EQUAL_UINT64(3'000U, window.totalUs(afterWrap));
+  TEST_ASSERT_EQUAL_UINT64(0U, window.totalUs(afterWrap + airtime::SlidingWindow::windowMs));
+}
+
+void
+testUtilisation()
+{
+  airtime::DutyCycleAccountant accountant;
+  TEST_ASSERT_TRUE(accountant.record(g_frequencyMhz, 36'000'000U, 0U));
+  TEST_ASSERT_FALSE(accountant.record(g_outsideFrequencyMhz, 1'000U, 0U));
+
+  TEST_ASSERT_FLOAT_WITHIN(1e-6F, 0.01F, accountant.utilisation(g_frequencyMhz, 1U));
+  TEST_ASSERT_EQUAL_FLOAT(0.0F, accountant.utilisation(g_otherFrequencyMhz, 1U));
+  TEST_ASSERT_EQUAL_FLOAT(0.0F, accountant.utilisation(g_outsideFrequencyMhz, 1U));
+}
+
+void
+testCanTransmitEnforcesSubBandLimit()
+{
+  airtime::DutyCycleAccountant accountant;
+  const uint32_t budgetUs{static_cast<uint32_t>(g_oneHourUs / 100U)};
+  TEST_ASSERT_TRUE(accountant.canTransmit(g_frequencyMhz, budgetUs, 0U));
+  TEST_ASSERT_FALSE(accountant.canTransmit(g_frequencyMhz, budgetUs + 1U, 0U));
+
+  accountant.record(g_frequencyMhz, budgetUs - 1'000U, 0U);
+  TEST_ASSERT_TRUE(accountant.canTransmit(g_frequencyMhz, 1'000U, 1U));
+  TEST_ASSERT_FALSE(accountant.canTransmit(g_frequencyMhz, 1'001U, 1U));
+  // other sub-bands have their own budget
+  TEST_ASSERT_TRUE(accountant.canTransmit(g_otherFrequencyMhz, budgetUs, 1U));
+  TEST_ASSERT_FALSE(accountant.canTransmit(g_outsideFrequencyMhz, 1U, 1U));
+  // the budget is back once the airtime left the window
+  TEST_ASSERT_TRUE(accountant.canTransmit(g_frequencyMhz, budgetUs, airtime::SlidingWindow::windowMs));
+}
+
+int
+main(int, char**)
+{
+  UNITY_BEGIN();
+  RUN_TEST(testTimeOnAirMatchesSemtechCalculator);
+  RUN_TEST(testTimeOnAirShortSpreadingFactors);
+  RUN_TEST(testTimeOnAirGrowsWithPayload);
+  RUN_TEST(testLowDataRateOptimizeSwitchesAt16Ms);
+  RUN_TEST(testCollisionProbability);
+  RUN_TEST(testSubBands);
+  RUN_TEST(testSlidingWindowExpiresBuckets);
+  RUN_TEST(testSlidingWindowReusesBucketsAfterLongIdle);
+  RUN_TEST(testSlidingWindowSurvivesMillisWrap);
+  RUN_TEST(testUtilisation);
+  RUN_TEST(testCanTransmitEnforcesSubBandLimit);
+  return UNITY_END();
+}
@@ -0,0 +1,196 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+#include <unity.h>
+
+#include "../ingest/IngestHarness.h"
+
+namespace {
+constexpr uint32_t g_mutationRounds{2'000U};
+constexpr std::size_t g_manyNodes{1'000U}; // more than any stage keeps state for
+
+// plaintexts of node packets, the same as the plaintext seeds of the fuzz corpus
+constexpr const char* g_seedMessages[]{
+  R"({"k":"fuzz","id":"node1","t":21.5,"hu":48.2,"b":90})",
+  R"({"k":"fuzz","id":"node-2","bt":"on","m":"off","rw":"hello"})",
+  R"({"k":"fuzz","id":"n_3","v":3.3,"pw":12.5,"l":400,"cd":800,"atm":101.3,"w":250.5})",
+  R"({"k":"fuzz","id":"gw","snr":99,"fe":1,"at":2,"ata":3,"ts":4,"cu":5,"cp":6,"wk":7,"awk":8,"wot":9})",
+  R"({"k":"other","id":"node1","t":1})",
+  R"({"k":"fuzz","id":"bad/id","t":1})",
+  R"({"k":"fuzz","id":"node1","t":{"nested":1}})",
+  R"({"k":"fuzz","id":"node1","s":"")",
+};
+
+std::vector<uint8_t>
+input(const uint8_t control, const char* const message)
+{
+  std::vector<uint8_t> data{control};
+  data.insert(data.end(), message, message + strlen(message));
+  return data;
+}
+
+std::vector<uint8_t>
+rawInput(std::vector<uint8_t> packet)
+{
+  packet.insert(packet.begin(), ingest::g_rawPacket);
+  return packet;
+}
+
+ingest::Result
+process(ingest::Harness& harness, const std::vector<uint8_t>& data)
+{
+  const auto result{harness.process(data.data(), data.size())};
+  if (result.violation != nullptr) {
+    TEST_FAIL_MESSAGE(result.violation);
+  }
+  return result;
+}
+
+// xorshift32, deterministic across platforms unlike std::rand()
+uint32_t
+nextRandom(uint32_t& state)
+{
+  state ^= state << 13U;
+  state ^= state >> 17U;
+  state ^= state << 5U;
+  return state;
+}
+
+void
+mutate(std::vector<uint8_t>& data, uint32_t& state)
+{
+  switch (nextRandom(state) % 4U) {
+    case 0U: // flip a bit, the control byte is left alone
+      if (data.size() > 1U) {
+        data[1U + (nextRandom(state) % (data.size() - 1U))] ^= static_cast<uint8_t>(1U << (nextRandom(state) % 8U));
+      }
+      break;
+    case 1U: // truncate
+      data.resize(1U + (nextRandom(state) % data.size()));
+      break;
+    case 2U: // append random bytes
+      for (uint32_t count{nextRandom(state) % 64U}; count > 0U; --count) {
+        data.push_back(static_cast<uint8_t>(nextRandom(state)));
+      }
+      break;
+    default: // overwrite a byte with a JSON special character
+      if (data.size() > 1U) {
+        constexpr std::array<char, 8U> characters{'{', '}', '"', ':', ',', '\\', '[', '\0'};
+        data[1U + (nextRandom(state) % (data.size() - 1U))] =
+          static_cast<uint8_t>(characters[nextRandom(state) % characters.size()]);
+      }
+      break;
+  }
+}
+} // namespace
+
+void
+setUp()
+{
+}
+
+void
+tearDown()
+{
+}
+
+void
+testValidPacketIsPublished()
+{
+  ingest::Harness harness{0U};
+  const auto result{process(harness, input(0U, R"({"k":"fuzz","id":"node1","t":21.5,"b":90})"))};
+
+  TEST_ASSERT_TRUE(result.decoded);
+  TEST_ASSERT_TRUE(result.published);
+  // discovery and state of b, t and the RSSI added by the gateway
+  TEST_ASSERT_EQUAL_size_t(6U, result.publishes);
+}
+
+void
+testPacketForOtherGatewayIsNotPublished()
+{
+  ingest::Harness harness{0U};
+  const auto result{process(harness, input(0U, R"({"k":"other","id":"node1","t":21.5})"))};
+
+  TEST_ASSERT_TRUE(result.decoded);
+  TEST_ASSERT_FALSE(result.published);
+  TEST_ASSERT_EQUAL_size_t(0U, result.publishes);
+}
+
+void
+testGatewayKeysFromNodesAreIgnored()
+{
+  ingest::Harness harness{0U};
+  const auto result{process(harness, input(0U, R"({"k":"fuzz","id":"node1","snr":99,"cu":5,"wot":7})"))};
+
+  // only the RSSI set by the gateway
+  TEST_ASSERT_EQUAL_size_t(2U, result.publishes);
+}
+
+void
+testMalformedHeadersAreRejected()
+{
+  ingest::Harness harness{0U};
+  // wrong version
+  TEST_ASSERT_FALSE(process(harness, rawInput({2U, ingest::g_nodeKeyId, 0U})).decoded);
+  // gateway key longer than the header allows, with a correctly sized ciphertext
+  constexpr std::size_t gatewayKeyLength{packet::PacketDecoder::maxGatewayKeyLength + 2U};
+  std::vector<uint8_t> longGatewayKey(packet::PacketDecoder::headerFixedLength + gatewayKeyLength + 32U, 'a');
+  longGatewayKey[0] = packet::PacketDecoder::headerVersion;
+  longGatewayKey[2] = gatewayKeyLength;
+  TEST_ASSERT_FALSE(process(harness, rawInput(longGatewayKey)).decoded);
+  // gateway key length beyond the packet
+  TEST_ASSERT_FALSE(process(harness, rawInput({packet::PacketDecoder::headerVersion, 1U, 12U, 'f'})).decoded);
+  // legacy packet that is too short for the IV
+  TEST_ASSERT_FALSE(process(harness, rawInput(std::vector<uint8_t>(16U, 0U))).decoded);
+  // longer than any LoRa packet
+  TEST_ASSERT_FALSE(process(harness, rawInput(std::vector<uint8_t>(512U, 0U))).decoded);
+}
+
+void
+testMutatedPacketsKeepInvariants()
+{
+  for (uint8_t options{0U}; options < ingest::g_optionCombinations; ++options) {
+    ingest::Harness harness{static_cast<uint8_t>(options << 1U)};
+    uint32_t state{0x9E3779B9U + options};
+    for (uint32_t round{0U}; round < g_mutationRounds; ++round) {
+      const char* const seed{g_seedMessages[round % std::size(g_seedMessages)]};
+      const bool raw{(nextRandom(state) % 4U) == 0U};
+      auto data{input(static_cast<uint8_t>((options << 1U) | (raw ? ingest::g_rawPacket : 0U)), seed)};
+      for (uint32_t mutations{nextRandom(state) % 4U}; mutations > 0U; --mutations) {
+        mutate(data, state);
+      }
+      process(harness, data);
+    }
+  }
+}
+
+void
+testStateStaysBoundedForManyNodes()
+{
+  for (const uint8_t options : {uint8_t{0U}, uint8_t{ingest::g_perDevice | ingest::g_aggregated}}) {
+    ingest::Harness harness{options};
+    for (std::size_t node{0U}; node < g_manyNodes; ++node) {
+      const String message{String{R"({"k":"fuzz","id":"node)"} + node + R"(","t":1,"hu":2,"b":3})"};
+      process(harness, input(options, message.c_str()));
+    }
+    TEST_ASSERT_EQUAL_UINT32(g_manyNodes, harness.statistics().packets);
+  }
+}
+
+int
+main(int, char**)
+{
+  UNITY_BEGIN();
+  RUN_TEST(testValidPacketIsPublished);
+  RUN_TEST(testPacketForOtherGatewayIsNotPublished);
+  RUN_TEST(testGatewayKeysFromNodesAreIgnored);
+  RUN_TEST(testMalformedHeadersAreRejected);
+  RUN_TEST(testMutatedPacketsKeepInvariants);
+  RUN_TEST(testStateStaysBoundedForManyNodes);
+  return UNITY_END();
+}
@@ -0,0 +1,95 @@
+// Throughput of the host build of the ingest path, including the encryption the harness does in place of the node.
+// The floor only catches gross regressions, the benchmark environment measures node populations and all modes.
+// Both state modes run with per entity discovery, so the publishes and bytes per packet only differ by the state
+// mode.
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+#include <unity.h>
+
+#include "../ingest/IngestHarness.h"
+
+namespace {
+constexpr std::size_t g_packets{20'000U};
+constexpr std::size_t g_nodes{64U};
+constexpr double g_minPacketsPerSecond{5'000.0};
+
+std::vector<std::vector<uint8_t>>
+makeInputs(const uint8_t options)
+{
+  std::vector<std::vector<uint8_t>> inputs;
+  inputs.reserve(g_nodes);
+  for (std::size_t node{0U}; node < g_nodes; ++node) {
+    const String message{String{R"({"k":"fuzz","id":"node)"} + node + R"(","t":21.5,"hu":48.2,"b":90,"v":3.3})"};
+    std::vector<uint8_t> data{options};
+    data.insert(data.end(), message.c_str(), message.c_str() + message.length());
+    inputs.push_back(std::move(data));
+  }
+  return inputs;
+}
+
+void
+measure(const uint8_t options, const char* const name)
+{
+  ingest::Harness harness{options};
+  const auto inputs{makeInputs(options)};
+
+  const auto start{std::chrono::steady_clock::now()};
+  for (std::size_t index{0U}; index < g_packets; ++index) {
+    const auto& data{inputs[index % inputs.size()]};
+    const auto result{harness.process(data.data(), data.size())};
+    TEST_ASSERT_NULL(result.violation);
+    TEST_ASSERT_TRUE(result.published);
+  }
+  const std::chrono::duration<double> elapsed{std::chrono::steady_clock::now() - start};
+
+  const double packetsPerSecond{static_cast<double>(g_packets) / elapsed.count()};
+  const auto& statistics{harness.statistics()};
+  char message[160];
+  snprintf(message,
+           sizeof(message),
+           "%s: %.0f packets/s, %.2f publishes/packet, %.0f bytes/packet",
+           name,
+           packetsPerSecond,
+           static_cast<double>(statistics.publishes) / statistics.packets,
+           static_cast<double>(statistics.publishedBytes) / statistics.packets);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_TRUE(packetsPerSecond >= g_minPacketsPerSecond);
+}
+} // namespace
+
+void
+setUp()
+{
+}
+
+void
+tearDown()
+{
+}
+
+void
+testPerKeyThroughput()
+{
+  measure(0U, "per key");
+}
+
+void
+testAggregatedThroughput()
+{
+  measure(ingest::g_aggregated, "aggregated");
+}
+
+int
+main(int, char**)
+{
+  UNITY_BEGIN();
+  RUN_TEST(testPerKeyThroughput);
+  RUN_TEST(testAggregatedThroughput);
+  return UNITY_END();
+}
@@ -0,0 +1,243 @@
+#include <Arduino.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <unity.h>
+
+#include <message/MessageProcessor.h>
+#include <message/Pipeline.h>
+#include <message/Stages.h>
+#include <packet/Packet.h>
+
+namespace {
+using namespace std::chrono_literals;
+
+constexpr auto g_gatewayId{"test"};
+constexpr auto g_temperatureTopic{"homeassistant/sensor/node1/tmp"};
+constexpr auto g_humidityTopic{"homeassistant/sensor/node1/humidity"};
+constexpr int64_t g_startUs{1'000'000};
+
+// Records the topics instead of sending them.
+struct MockSink
+{
+  std::vector<String>* topics;
+
+  bool operator()(const char* const topic, const char*, std::size_t, bool) const
+  {
+    topics->emplace_back(topic);
+    return true;
+  }
+};
+
+// Fails every publish while the broker is not connected.
+struct FlakySink
+{
+  const bool* connected;
+
+  bool operator()(const char*, const char*, std::size_t, bool) const
+  {
+    return *connected;
+  }
+};
+
+using Processor = message::MessageProcessor<MockSink>;
+
+message::PipelineContext
+decode(const char* const payload, const int64_t timestampUs)
+{
+  message::PipelineContext context{packet::Packet{
+    payload,
+    {.rssi = -90.0F, .snr = 7.5F, .frequencyError = 0.0F, .timestampUs = timestampUs, .airtimeUs = 50'000U},
+  }};
+  TEST_ASSERT_TRUE(message::JsonDecoder(g_gatewayId, false)(context));
+  return context;
+}
+
+bool
+published(const std::vector<String>& topics, const char* const topic)
+{
+  return std::find(topics.begin(), topics.end(), String{topic}) != topics.end();
+}
+} // namespace
+
+void
+setUp()
+{
+}
+
+void
+tearDown()
+{
+}
+
+void
+testDedupFilterDropsRetransmissions()
+{
+  message::DedupFilter filter{2s};
+  constexpr auto payload{R"({"k":"test","id":"node1","t":21.5})"};
+
+  TEST_ASSERT_TRUE(filter(decode(payload, g_startUs)));
+  TEST_ASSERT_FALSE(filter(decode(payload, g_startUs + 1'999'000)));
+  // after the window, the same value sent periodically passes again
+  TEST_ASSERT_TRUE(filter(decode(payload, g_startUs + 2'000'000)));
+  // another payload or another node within the window
+  TEST_ASSERT_TRUE(filter(decode(R"({"k":"test","id":"node1","t":21.6})", g_startUs + 2'001'000)));
+  TEST_ASSERT_TRUE(filter(decode(R"({"k":"test","id":"node2","t":21.6})", g_startUs + 2'002'000)));
+}
+
+void
+testDedupFilterIsDisabledByZeroWindow()
+{
+  message::DedupFilter filter{0ms};
+  constexpr auto payload{R"({"k":"test","id":"node1","t":21.5})"};
+
+  TEST_ASSERT_TRUE(filter(decode(payload, g_startUs)));
+  TEST_ASSERT_TRUE(filter(decode(payload, g_startUs)));
+}
+
+void
+testDeadbandFilterRemovesSmallChanges()
+{
+  message::DeadbandFilter filter{"t", 0.5};
+
+  auto first{decode(R"({"k":"test","id":"node1","t":21.5,"hu":40})", g_startUs)};
+  TEST_ASSERT_TRUE(filter(first));
+  TEST_ASSERT_TRUE(first.doc["t"].is<double>());
+
+  // within the band the key is removed, the other keys are kept
+  auto within{decode(R"({"k":"test","id":"node1","t":21.9,"hu":41})", g_startUs + 1)};
+  TEST_ASSERT_TRUE(filter(within));
+  TEST_ASSERT_FALSE(within.doc["t"].is<double>());
+  TEST_ASSERT_TRUE(within.doc["hu"].is<double>());
+
+  // the band stays around the last value passed on, not the last value received
+  auto exceeded{decode(R"({"k":"test","id":"node1","t":22.0})", g_startUs + 2)};
+  TEST_ASSERT_TRUE(filter(exceeded));
+  TEST_ASSERT_EQUAL_FLOAT(22.0F, exceeded.doc["t"].as<float>());
+
+  auto updated{decode(R"({"k":"test","id":"node1","t":22.4})", g_startUs + 3)};
+  TEST_ASSERT_TRUE(filter(updated));
+  TEST_ASSERT_FALSE(updated.doc["t"].is<double>());
+}
+
+void
+testDeadbandFilterIsDisabledByZeroDeadband()
+{
+  message::DeadbandFilter filter{"t", 0.0};
+
+  auto first{decode(R"({"k":"test","id":"node1","t":21.5})", g_startUs)};
+  TEST_ASSERT_TRUE(filter(first));
+  auto same{decode(R"({"k":"test","id":"node1","t":21.5})", g_startUs + 1)};
+  TEST_ASSERT_TRUE(filter(same));
+  TEST_ASSERT_TRUE(same.doc["t"].is<double>());
+}
+
+void
+testMetricsTapCountsPackets()
+{
+  message::PipelineMetrics metrics;
+  const message::MetricsTap tap{metrics};
+  constexpr auto payload{R"({"k":"test","id":"node1","t":21.5})"};
+
+  TEST_ASSERT_TRUE(tap(decode(payload, g_startUs)));
+  TEST_ASSERT_TRUE(tap(decode(payload, g_startUs + 5)));
+  TEST_ASSERT_EQUAL_UINT32(2U, metrics.packets);
+  TEST_ASSERT_EQUAL_UINT32(2U * strlen(payload), metrics.bytes);
+  TEST_ASSERT_EQUAL_INT64(g_startUs + 5, metrics.lastTimestampUs);
+}
+
+void
+testPipelinePublishesFilteredPackets()
+{
+  std::vector<String> topics;
+  Processor processor{MockSink{&topics}, g_gatewayId};
+  message::PipelineMetrics decoded;
+  message::PipelineMetrics passed;
+  message::Pipeline pipeline{message::MetricsTap{decoded},
+                             message::DedupFilter{2s},
+                             message::DeadbandFilter{"t", 0.5},
+                             message::MetricsTap{passed},
+                             message::Publisher{processor}};
+
+  auto first{decode(R"({"k":"test","id":"node1","t":21.5,"hu":40})", g_startUs)};
+  TEST_ASSERT_TRUE(pipeline.process(first));
+  TEST_ASSERT_TRUE(published(topics, g_temperatureTopic));
+  TEST_ASSERT_TRUE(published(topics, g_humidityTopic));
+
+  // a retransmission stops at the DedupFilter, nothing is published
+  topics.clear();
+  auto retransmission{decode(R"({"k":"test","id":"node1","t":21.5,"hu":40})", g_startUs + 1'000)};
+  TEST_ASSERT_FALSE(pipeline.process(retransmission));
+  TEST_ASSERT_TRUE(topics.empty());
+
+  // the temperature stays within the deadband, only the humidity is published
+  auto update{decode(R"({"k":"test","id":"node1","t":21.6,"hu":42})", g_startUs + 2'000)};
+  TEST_ASSERT_TRUE(pipeline.process(update));
+  TEST_ASSERT_FALSE(published(topics, g_temperatureTopic));
+  TEST_ASSERT_TRUE(published(topics, g_humidityTopic));
+
+  TEST_ASSERT_EQUAL_UINT32(3U, decoded.packets);
+  TEST_ASSERT_EQUAL_UINT32(2U, passed.packets);
+  TEST_ASSERT_EQUAL_UINT32(2U, processor.statistics().packets);
+}
+
+void
+testFailedDeviceConfigIsSentAgain()
+{
+  bool connected{false};
+  message::MessageProcessor<FlakySink> processor{
+    FlakySink{&connected}, g_gatewayId, {.discoveryMode = message::DiscoveryMode::PerDevice}};
+  constexpr auto payload{R"({"k":"test","id":"node1","t":21.5})"};
+
+  processor.publishUpdate(decode(payload, g_startUs).doc);
+  TEST_ASSERT_TRUE(processor.discoveredKeys().empty());
+  TEST_ASSERT_EQUAL_UINT32(0U, processor.discoveryRevision());
+
+  connected = true;
+  processor.publishUpdate(decode(payload, g_startUs + 1).doc);
+  TEST_ASSERT_EQUAL_size_t(1U, processor.discoveredKeys().size());
+  TEST_ASSERT_EQUAL_UINT32(1U, processor.discoveryRevision());
+}
+
+void
+testLeastRecentNodeIsForgotten()
+{
+  std::vector<String> topics;
+  Processor processor{MockSink{&topics}, g_gatewayId, {.discoveryMode = message::DiscoveryMode::PerDevice}};
+  const auto publishTemperature{[&processor](const std::size_t node) {
+    const String payload{String{R"({"k":"test","id":"node)"} + node + R"(","t":21.5})"};
+    processor.publishUpdate(decode(payload.c_str(), g_startUs).doc);
+  }};
+
+  for (std::size_t node{0U}; node < Processor::maxDiscoveredNodes; ++node) {
+    publishTemperature(node);
+  }
+  publishTemperature(0U); // heard again, node1 is the least recent now
+  publishTemperature(Processor::maxDiscoveredNodes);
+
+  const auto discoveredKeys{processor.discoveredKeys()};
+  TEST_ASSERT_EQUAL_size_t(Processor::maxDiscoveredNodes, discoveredKeys.size());
+  TEST_ASSERT_EQUAL_size_t(1U, discoveredKeys.count("node0"));
+  TEST_ASSERT_EQUAL_size_t(0U, discoveredKeys.count("node1"));
+  TEST_ASSERT_EQUAL_size_t(1U, discoveredKeys.count(String{"node"} + Processor::maxDiscoveredNodes));
+}
+
+int
+main(int, char**)
+{
+  UNITY_BEGIN();
+  RUN_TEST(testDedupFilterDropsRetransmissions);
+  RUN_TEST(testDedupFilterIsDisabledByZeroWindow);
+  RUN_TEST(testDeadbandFilterRemovesSmallChanges);
+  RUN_TEST(testDeadbandFilterIsDisabledByZeroDeadband);
+  RUN_TEST(testMetricsTapCountsPackets);
+  RUN_TEST(testPipelinePublishesFilteredPackets);
+  RUN_TEST(testFailedDeviceConfigIsSentAgain);
+  RUN_TEST(testLeastRecentNodeIsForgotten);
+  return UNITY_END();
+}